@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libtssb.c>
+#include <libessb.c>
+#include <libssb_packed.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MIN_SECONDS 0.05 // every operation is repeated at least that long
+#define ESSB_SEGMENTS 20000
+#define GATHER_BATCH 32 // cells of one response, amount of cells in every shape is a multiple of it
+
+const char tssb_filename[] = "benchdata_suite.tssb";
+const char essb_filename[] = "benchdata_suite.essb";
+
+static const struct {
+	const char *name;
+	uint32_t rows;
+	uint32_t cols;
+} shapes[] = {{"tall", 10000, 10}, {"square", 1000, 100}, {"wide", 100, 1000}};
+
+static const unsigned key_percents[] = {1, 10, 50};
+
+typedef struct {
+	const char *format; // tssb, tssb_packed, tssb_pooled or essb
+	const char *shape; // name of table shape, or template
+	unsigned param; // width of size fields for tssb, percent of keys for essb
+	size_t bytes; // size of file
+	size_t cells; // amount of cells (tssb) or records (essb)
+} bench_case;
+
+static bool json;
+static const char *checks = SSB_CHECKED ? "fused" : "off"; // build with -DSSB_UNCHECKED to see what validation costs
+static volatile size_t sink; // results of cell access go there, so it's not optimized away
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void) {
+	// above
+	// ru_maxrss never goes down, so every case runs in its own child process (see IN_CHILD), and column shows peak
+	// of current case up to reported operation instead of peak of all cases which were run before.
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) < 0) return -1;
+	return usage.ru_maxrss;
+}
+
+static void report(const bench_case *c, const char *operation, double seconds, unsigned iterations) {
+	double per_iteration = seconds / iterations;
+	double ns_per_cell = per_iteration * 1e9 / c->cells;
+	double mb_per_s = c->bytes / per_iteration / 1e6;
+	if (json) printf("{\"format\":\"%s\",\"operation\":\"%s\",\"shape\":\"%s\",\"param\":%u,\"bytes\":%zu,\"cells\":%zu,"
+		"\"iterations\":%u,\"ns_per_cell\":%.3f,\"mb_per_s\":%.1f,\"peak_rss_kb\":%ld,\"checks\":\"%s\"}\n", c->format, operation,
+		c->shape, c->param, c->bytes, c->cells, iterations, ns_per_cell, mb_per_s, peak_rss_kb(), checks);
+	else printf("%s,%s,%s,%u,%zu,%zu,%u,%.3f,%.1f,%ld,%s\n", c->format, operation, c->shape, c->param, c->bytes, c->cells,
+		iterations, ns_per_cell, mb_per_s, peak_rss_kb(), checks);
+	fflush(stdout);
+}
+
+#define MEASURE(c, operation, body) do { \
+	unsigned iterations = 0; \
+	double start = now(), elapsed; \
+	do { \
+		body; \
+		iterations++; \
+	} while ((elapsed = now() - start) < MIN_SECONDS); \
+	report(c, operation, elapsed, iterations); \
+} while (0)
+// above
+// Repeats _body_ until MIN_SECONDS are passed and reports average time of single iteration.
+
+#define FAIL(what, reason) do {printf("%s failed: %s\n", what, reason); return false;} while (0)
+
+static bool wait_case(pid_t pid) {
+	int status;
+	if (pid < 0) FAIL("fork", strerror(errno));
+	while (waitpid(pid, &status, 0) < 0) if (errno != EINTR) FAIL("waitpid", strerror(errno));
+	return WIFEXITED(status) and WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+#define IN_CHILD(call) (fflush(stdout), (case_pid = fork()) == 0 ? (exit((call) ? EXIT_SUCCESS : EXIT_FAILURE), false) : \
+	wait_case(case_pid))
+// above
+// Runs bench case in child process, so its peak RSS is not affected by other cases. Output of parent is flushed
+// first, otherwise child would print it again.
+
+static pid_t case_pid;
+
+static bool generate_tssb(unsigned width, uint32_t rows, uint32_t cols, size_t *bytes) {
+	// above
+	// Writes table with cells of random size (0 ... 32 bytes) and _width_ bytes size fields.
+
+	FILE *f = fopen(tssb_filename, "wb");
+	if (f == NULL) return false;
+	char header[32];
+	size_t length = strlen(signatures[width]);
+	memcpy(header, signatures[width], length);
+	put_le(header + length, rows, sizeof(uint32_t));
+	put_le(header + length + sizeof(uint32_t), cols, sizeof(uint32_t));
+	fwrite(header, 1, length + sizeof(uint32_t) * 2, f);
+	char payload[32 + sizeof(uint64_t)];
+	memset(payload, 'x', sizeof(payload));
+	for (uint32_t row = 0; row < rows; row++) {
+		put_le(payload, UINT64_MAX, width);
+		fwrite(payload, 1, width, f);
+		for (uint32_t col = 0; col < cols; col++) {
+			size_t size = rand() % 33;
+			put_le(payload, size, width);
+			fwrite(payload, 1, width + size, f);
+			memset(payload, 'x', width);
+		}
+	}
+	*bytes = ftell(f);
+	return fclose(f) == 0;
+}
+
+static bool bench_tssb(unsigned width, uint32_t rows, uint32_t cols, const char *shape) {
+	bench_case c = {.format = "tssb", .shape = shape, .param = width, .cells = (size_t) rows * cols};
+	if (generate_tssb(width, rows, cols, &c.bytes) == false) FAIL("generate_tssb", strerror(errno));
+
+	tssb u;
+	MEASURE(&c, "check_tssb", u = check_tssb(tssb_filename); if (u.errreasonstr) FAIL("check_tssb", u.errreasonstr));
+	MEASURE(&c, "prepare_tssb", u = prepare_tssb(tssb_filename, NULL, 0); if (u.errreasonstr) FAIL("prepare_tssb", u.errreasonstr); release_tssb(&u));
+	MEASURE(&c, "prepare_tssb_mmap", u = prepare_tssb_mmap(tssb_filename, NULL, 0); if (u.errreasonstr) FAIL("prepare_tssb_mmap", u.errreasonstr); release_tssb(&u));
+	MEASURE(&c, "prepare_tssb_indexed", tssb_shared s = prepare_tssb_indexed(tssb_filename); if (s.errreasonstr) FAIL("prepare_tssb_indexed", s.errreasonstr); detach_tssb_shared(&s));
+
+	u = prepare_tssb(tssb_filename, NULL, 0);
+	if (u.errreasonstr) FAIL("prepare_tssb", u.errreasonstr);
+	char ***t = NULL;
+	MEASURE(&c, "parse_tssb", t = parse_tssb(&u); if (t == NULL) FAIL("parse_tssb", u.errreasonstr));
+	MEASURE(&c, "cell_access", size_t sum = 0; size_t size;
+		for (size_t row = 0; row < rows; row++) for (size_t col = 0; t[row][col] != NULL; col++) sum += getssbsize(t[row][col], u, &size);
+		sink += sum);
+	uint32_t *index = index_tssb32(&u, NULL, 0);
+	if (index == NULL) FAIL("index_tssb32", u.errreasonstr);
+	MEASURE(&c, "index_tssb32", if (index_tssb32(&u, index, TSSB_CALCULATE_INDEX32(u)) == NULL) FAIL("index_tssb32", u.errreasonstr));
+	MEASURE(&c, "cell_access_index32", size_t sum = 0; size_t size;
+		for (size_t i = 0; i < c.cells; i++) sum += index[i] ? getssbsize(u.source + index[i], u, &size) : 0;
+		sink += sum);
+
+	// responses of GATHER_BATCH random cells: one by one, then with gather_tssb*() family
+	tssb_cell_ref *refs = malloc(c.cells * sizeof(tssb_cell_ref));
+	tssb_cell_view views[GATHER_BATCH];
+	if (refs == NULL) FAIL("malloc", strerror(errno));
+	for (size_t i = 0; i < c.cells; i++) refs[i] = (tssb_cell_ref) {.row = rand() % rows, .col = rand() % cols};
+	MEASURE(&c, "cell_access_random", size_t sum = 0; size_t size;
+		for (size_t i = 0; i < c.cells; i++) sum += t[refs[i].row][refs[i].col] ? getssbsize(t[refs[i].row][refs[i].col], u, &size) : 0;
+		sink += sum);
+	MEASURE(&c, "gather_tssb", size_t sum = 0;
+		for (size_t i = 0; i < c.cells; i += GATHER_BATCH) sum += gather_tssb(&u, refs + i, GATHER_BATCH, views);
+		sink += sum);
+	MEASURE(&c, "gather_tssb32", size_t sum = 0;
+		for (size_t i = 0; i < c.cells; i += GATHER_BATCH) sum += gather_tssb32(&u, index, refs + i, GATHER_BATCH, views);
+		sink += sum);
+	free(refs);
+	free(index);
+
+	MEASURE(&c, "prepare_tssb_addr", tssb a = prepare_tssb_addr(SOURCE_ADDR, u.source, u.size, NULL, 0); if (a.errreasonstr) FAIL("prepare_tssb_addr", a.errreasonstr); release_tssb(&a));
+	MEASURE(&c, "prepare_tssb_addr_inplace+parse", tssb a = prepare_tssb_addr(SOURCE_ADDR_INPLACE, u.source, u.size, NULL, 0);
+		if (a.errreasonstr or parse_tssb(&a) == NULL) FAIL("prepare_tssb_addr_inplace", a.errreasonstr); release_tssb(&a));
+	release_tssb(&u);
+	return true;
+}
+
+static size_t packed_row_sum(tssb_packed *p, size_t row) {
+	size_t sum = 0, size;
+	char **r = tssb_packed_row(p, row);
+	if (r != NULL) for (size_t col = 0; r[col] != NULL; col++) sum += getssbsize(r[col], p->u, &size);
+	return sum;
+}
+
+static bool bench_packed(unsigned width, uint32_t rows, uint32_t cols, const char *shape) {
+	// above
+	// Same table as bench_tssb() has, but block-compressed. bytes column is the size of compressed object, so
+	// it shows compression ratio too. Sequential walk decompresses every block, while random rows of working set
+	// which fits in cache show the cost of hit.
+
+	bench_case c = {.format = "tssb_packed", .shape = shape, .param = width, .cells = (size_t) rows * cols};
+	tssb u = prepare_tssb(tssb_filename, NULL, 0);
+	if (u.errreasonstr) FAIL("prepare_tssb", u.errreasonstr);
+	size_t bound = calculate_tssb_pack(&u, 0);
+	char *packed = malloc(bound);
+	if (packed == NULL) FAIL("malloc", strerror(errno));
+	MEASURE(&c, "pack_tssb", c.bytes = pack_tssb(&u, 0, packed, bound); if (c.bytes == 0) FAIL("pack_tssb", u.errreasonstr));
+	release_tssb(&u);
+
+	tssb_packed p;
+	MEASURE(&c, "prepare_tssb_packed_addr", p = prepare_tssb_packed_addr(packed, c.bytes, 0); if (p.errreasonstr) FAIL("prepare_tssb_packed_addr", p.errreasonstr); release_tssb_packed(&p));
+	p = prepare_tssb_packed_addr(packed, c.bytes, 0);
+	MEASURE(&c, "cell_access_packed", size_t sum = 0; for (size_t row = 0; row < rows; row++) sum += packed_row_sum(&p, row); sink += sum);
+	uint32_t *order = malloc(rows * sizeof(uint32_t));
+	if (order == NULL) FAIL("malloc", strerror(errno));
+	for (uint32_t i = 0; i < rows; i++) order[i] = rand() % (TSSB_PACKED_ROWS * TSSB_PACKED_CACHE) % rows;
+	MEASURE(&c, "cell_access_packed_hot", size_t sum = 0; for (size_t i = 0; i < rows; i++) sum += packed_row_sum(&p, order[i]); sink += sum);
+	free(order);
+	release_tssb_packed(&p);
+	free(packed);
+	return true;
+}
+
+static bool bench_pooled(unsigned width, uint32_t rows, uint32_t cols, const char *shape) {
+	// above
+	// Same table as bench_tssb() has, but built with TSSB_BUILD_POOLED. Generated cells differ only by size, so
+	// there are at most 33 distinct ones, and bytes column shows the size of offset table mostly.
+
+	bench_case c = {.format = "tssb_pooled", .shape = shape, .param = width, .cells = (size_t) rows * cols};
+	tssb u = prepare_tssb(tssb_filename, NULL, 0);
+	char ***t = u.errreasonstr ? NULL : parse_tssb(&u);
+	if (t == NULL) FAIL("parse_tssb", u.errreasonstr);
+	tssb_builder b = {.options = TSSB_BUILD_POOLED};
+	size_t size;
+	for (size_t row = 0; row < rows; row++) {
+		add_tssb_row(&b);
+		for (size_t col = 0; t[row][col] != NULL; col++) add_tssb_cell(&b, t[row][col], getssbsize(t[row][col], u, &size));
+	}
+	release_tssb(&u);
+	size_t bound = calculate_tssb_build(&b);
+	char *pooled = bound ? malloc(bound) : NULL;
+	if (pooled == NULL) FAIL("calculate_tssb_build", b.errreasonstr ? b.errreasonstr : strerror(errno));
+	MEASURE(&c, "build_tssb_pooled", c.bytes = build_tssb(&b, pooled, bound); if (c.bytes == 0) FAIL("build_tssb", b.errreasonstr));
+	release_tssb_builder(&b);
+
+	tssb_shared s;
+	MEASURE(&c, "prepare_tssb_indexed_addr", s = prepare_tssb_indexed_addr(pooled, c.bytes); if (s.errreasonstr) FAIL("prepare_tssb_indexed_addr", s.errreasonstr); detach_tssb_shared(&s));
+	s = prepare_tssb_indexed_addr(pooled, c.bytes);
+	MEASURE(&c, "cell_access_pooled", size_t sum = 0;
+		for (size_t i = 0; i < c.cells; i++) sum += s.index[i] ? getssbsize(TSSB_CELL32(s.u, s.index, 0, i), s.u, &size) : 0;
+		sink += sum);
+	detach_tssb_shared(&s);
+	free(pooled);
+	return true;
+}
+
+static bool generate_essb(unsigned percent, size_t *bytes) {
+	// above
+	// Template of ESSB_SEGMENTS segments, every one is a key with _percent_ probability, otherwise it's static text.
+	// Adjacent static segments are merged into one record, of course.
+
+	char *text = malloc(ESSB_SEGMENTS * 64);
+	if (text == NULL) return false;
+	size_t size = 0;
+	for (unsigned i = 0; i < ESSB_SEGMENTS; i++) {
+		bool key = (unsigned) (rand() % 100) < percent;
+		size_t length = key ? 4 + rand() % 13 : 16 + rand() % 33;
+		if (key) size += sprintf(text + size, "{{");
+		for (size_t j = 0; j < length; j++) text[size++] = 'a' + rand() % 26;
+		if (key) size += sprintf(text + size, "}}");
+	}
+
+	bool success = false;
+	size_t required = check_essb_template(text, size, "{{", "}}");
+	int32_t *buffer = malloc(required);
+	essb e = {0};
+	if (buffer != NULL and compile_essb(&e, text, size, "{{", "}}", buffer, required)) {
+		*bytes = sizeof(struct essb_format) + ESSB_CALCULATE_FILE(e);
+		FILE *f = fopen(essb_filename, "wb");
+		if (f != NULL) success = fwrite(buffer, 1, *bytes, f) == *bytes and fclose(f) == 0;
+		release_essb(&e);
+	}
+	free(buffer);
+	free(text);
+	return success;
+}
+
+static char *read_file(const char *name, size_t *size, size_t spare) {
+	// above
+	// Reads whole file to memory, with _spare_ bytes after it.
+
+	int fd = open(name, O_RDONLY);
+	if (fd < 0) return NULL;
+	char *data = NULL;
+	if (fstat_getsize(fd, size) == 0 and (data = malloc(*size + spare)) != NULL and read(fd, data, *size) != (ssize_t) *size) {
+		free(data);
+		data = NULL;
+	}
+	close(fd);
+	return data;
+}
+
+static bool make_foreign(char *file, size_t size) {
+	// above
+	// Converts generated file to byte order of other platform and writes it back.
+
+	essb e = {0};
+	if (check_essb_signature(&e, (const void *) file, size) == false) return false;
+	char *table = file + sizeof(struct essb_format) + e.records_total_size + ESSB_CALCULATE_RESIDUE(e);
+	bswap32_bulk_priv_ssb(table, table, e.records_amount);
+	bswap32_bulk_priv_ssb(file + strizeof(essb_signature_0), file + strizeof(essb_signature_0), 2);
+	FILE *f = fopen(essb_filename, "wb");
+	return f != NULL and fwrite(file, 1, size, f) == size and fclose(f) == 0;
+}
+
+static bool bench_essb(unsigned percent, bool foreign) {
+	// above
+	// Foreign file has byte order of other platform, so it shows what bulk swap of sizes costs.
+
+	bench_case c = {.format = "essb", .shape = foreign ? "template_foreign" : "template", .param = percent};
+	if (generate_essb(percent, &c.bytes) == false) FAIL("generate_essb", strerror(errno));
+	size_t size;
+	char *file = read_file(essb_filename, &size, 0);
+	if (file == NULL) FAIL("read_file", strerror(errno));
+	if (foreign and make_foreign(file, size) == false) FAIL("make_foreign", strerror(errno));
+	uint32_t required = check_essb(SOURCE_ADDR, file);
+	c.cells = check_essb(SOURCE_MMAP, essb_filename) / sizeof(int32_t);
+	char *inplace = malloc(sizeof(struct essb_format) + required);
+	char *stackmem = malloc(required);
+	if (inplace == NULL or stackmem == NULL) FAIL("malloc", strerror(errno));
+	memcpy(inplace, file, size);
+
+	essb e = {0};
+	MEASURE(&c, "check_essb", if (check_essb(SOURCE_FILE, essb_filename) == 0) FAIL("check_essb", "zero"));
+	MEASURE(&c, "parse_essb_file", if (parse_essb(&e, SOURCE_FILE, essb_filename, NULL) == false) FAIL("parse_essb", e.errreasonstr); release_essb(&e));
+	MEASURE(&c, "parse_essb_file_stackmem", if (parse_essb(&e, SOURCE_FILE, essb_filename, stackmem) == false) FAIL("parse_essb", e.errreasonstr); release_essb(&e));
+	MEASURE(&c, "parse_essb_mmap", if (parse_essb(&e, SOURCE_MMAP, essb_filename, NULL) == false) FAIL("parse_essb", e.errreasonstr); release_essb(&e));
+	MEASURE(&c, "parse_essb_addr", if (parse_essb(&e, SOURCE_ADDR, file, NULL) == false) FAIL("parse_essb", e.errreasonstr); release_essb(&e));
+	if (foreign == false) { // foreign layout is converted to native one in place
+		MEASURE(&c, "parse_essb_addr_inplace", if (parse_essb(&e, SOURCE_ADDR_INPLACE, inplace, inplace) == false) FAIL("parse_essb", e.errreasonstr); release_essb(&e));
+	}
+
+	if (parse_essb(&e, SOURCE_ADDR_INPLACE, inplace, inplace) == false) FAIL("parse_essb", e.errreasonstr);
+	MEASURE(&c, "record_access", size_t sum = 0;
+		for (uint32_t i = 0; i < e.records_amount; i++) sum += (unsigned char) *ESSB_RETRIEVE(e, i) + (size_t) e.record_size[i];
+		sink += sum);
+	void *keys = malloc(check_essb_keys(&e) + 1);
+	MEASURE(&c, "index_essb_keys", e.keys = NULL; if (index_essb_keys(&e, keys) == false) FAIL("index_essb_keys", e.errreasonstr));
+	release_essb(&e);
+	free(keys);
+
+	free(stackmem);
+	free(inplace);
+	free(file);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	json = argc > 1 and strcmp(argv[1], "--json") == 0;
+	max_acceptable_dimension_size = 10000;
+	srand(42);
+	if (json == false) printf("format,operation,shape,param,bytes,cells,iterations,ns_per_cell,mb_per_s,peak_rss_kb,checks\n");
+
+	int retval = EXIT_SUCCESS;
+	for (unsigned width = 1; width <= sizeof(uint64_t) and retval == EXIT_SUCCESS; width *= 2) {
+		for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+			if (IN_CHILD(bench_tssb(width, shapes[i].rows, shapes[i].cols, shapes[i].name)) == false or
+				IN_CHILD(bench_packed(width, shapes[i].rows, shapes[i].cols, shapes[i].name)) == false or
+				IN_CHILD(bench_pooled(width, shapes[i].rows, shapes[i].cols, shapes[i].name)) == false) {
+				retval = EXIT_FAILURE;
+				break;
+			}
+		}
+	}
+	for (size_t i = 0; i < sizeof(key_percents) / sizeof(key_percents[0]) and retval == EXIT_SUCCESS; i++) {
+		if (IN_CHILD(bench_essb(key_percents[i], false)) == false or IN_CHILD(bench_essb(key_percents[i], true)) == false) retval = EXIT_FAILURE;
+	}
+
+	unlink(tssb_filename);
+	unlink(essb_filename);
+	return retval;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libtssb.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define ROWS 1000
+#define COLS 100
+#define REPEAT 50
+
+const char filename[] = "benchdata_tssb.ssb";
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool generate(unsigned width) {
+	// above
+	// Write ROWS x COLS table with cells of random size (0 ... 32 bytes) and _width_ bytes size fields
+
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL) return false;
+	uint32_t rowncol[2] = {ROWS, COLS};
+	const uint64_t sigil = UINT64_MAX;
+	char payload[32];
+	memset(payload, 'x', sizeof(payload));
+	fwrite(signatures[width], 1, strlen(signatures[width]), f);
+	fwrite(rowncol, 1, sizeof(rowncol), f);
+	for (unsigned row = 0; row < ROWS; row++) {
+		fwrite(&sigil, 1, width, f);
+		for (unsigned col = 0; col < COLS; col++) {
+			uint64_t size = rand() % (sizeof(payload) + 1);
+			fwrite(&size, 1, width, f); // little endian only
+			fwrite(payload, 1, size, f);
+		}
+	}
+	return fclose(f) == 0;
+}
+
+static char ***parse_generic(tssb *p) {
+	// above
+	// parse_tssb() as it was before width specialized loops, for comparison
+
+	tssb u = *p;
+	const uint8_t newline_sigil[8] = {UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX};
+	char ***t = set_2ndptrs(u);
+	size_t currentpos = strlen(signatures[u.sizestorage]) + sizeof(uint32_t) + sizeof(uint32_t);
+	if (memcmp(u.source + currentpos, newline_sigil, u.sizestorage) != 0) return NULL;
+	size_t bsize = 0, a = 0, b = 0; a--;
+
+	while(currentpos < u.size) {
+		if (memcmp(u.source + currentpos, newline_sigil, u.sizestorage) == 0) {
+			a++;
+			if (a >= u.rows) return NULL;
+			currentpos += u.sizestorage;
+			b = 0;
+			continue;
+		}
+		if (b >= u.cols) return NULL;
+		memcpy(&bsize, u.source + currentpos, u.sizestorage);
+		currentpos += u.sizestorage;
+		t[a][b++] = u.source + currentpos;
+		currentpos += bsize;
+	}
+
+	return t;
+}
+
+int main(int argc, char **argv) {
+	max_acceptable_dimension_size = ROWS;
+	srand(42);
+	printf("signature,generic_cells_per_sec,specialized_cells_per_sec,speedup\n");
+
+	for (unsigned width = 1; width <= sizeof(uint64_t); width *= 2) {
+		if (generate(width) == false) return perror("Can't generate benchmark data"), EXIT_FAILURE;
+		tssb u = prepare_tssb(filename, NULL, 0);
+		unlink(filename);
+		if (u.errreasonstr != NULL) return printf("%s\n", u.errreasonstr), EXIT_FAILURE;
+
+		double start = now();
+		for (unsigned i = 0; i < REPEAT; i++) if (parse_generic(&u) == NULL) return printf("generic parse failed\n"), EXIT_FAILURE;
+		double generic = now() - start;
+
+		start = now();
+		for (unsigned i = 0; i < REPEAT; i++) if (parse_tssb(&u) == NULL) return printf("%s\n", u.errreasonstr), EXIT_FAILURE;
+		double specialized = now() - start;
+
+		double cells = (double) ROWS * COLS * REPEAT;
+		printf("%s,%.0f,%.0f,%.2f\n", signatures[width], cells / generic, cells / specialized, generic / specialized);
+		release_tssb(&u);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -48,7 +48,7 @@ int main(int argc, char **argv) {
 		write(STDOUT_FILENO, "\n", 1);
 	}
 
-	free(e->records);
+	release_essb(e);
 
 	return EXIT_SUCCESS;
 }
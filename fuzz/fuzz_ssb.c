@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libtssb.c>
+#include <libessb.c>
+#include <libssb_packed.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+// Input is treated as TSSB (regular, pre-indexed or pooled), block-compressed TSSB and ESSB object. Every accepted
+// cell and record is read completely, so sanitizers are reporting any pointer which is going outside of input.
+// Built with -DSSB_LIBFUZZER, this file is a regular libFuzzer target. Otherwise it's a standalone program, which
+// replays files passed as arguments, or mutates built-in seeds if there are no arguments.
+
+static volatile uint64_t sink;
+
+static void touch(const void *data, size_t size) {
+	sink ^= hash_priv_ssb(data, size);
+}
+
+static char *duplicate(const uint8_t *data, size_t size) {
+	// above
+	// Exact size copy, because libraries are swapping sizes in place on big endian platforms, and also so that any
+	// read beyond the end is a heap overflow.
+
+	char *copy = malloc(size ? size : 1);
+	if (copy != NULL) memcpy(copy, data, size);
+	return copy;
+}
+
+static void fuzz_tssb(const uint8_t *data, size_t size) {
+	size_t cellsize;
+	char *copy = duplicate(data, size);
+	if (copy == NULL) return;
+	tssb u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, copy, size, NULL, 0);
+	char ***t = parse_tssb(&u);
+	if (t != NULL) for (size_t row = 0; row < u.rows; row++) {
+		for (size_t col = 0; t[row][col] != NULL; col++) touch(t[row][col], getssbsize(t[row][col], u, &cellsize));
+	}
+	release_tssb(&u);
+
+	memcpy(copy, data, size);
+	u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, copy, size, NULL, 0);
+	if (parse_tssb_lazy(&u)) {
+		char **r = tssb_row(&u, u.rows - 1);
+		if (r != NULL) for (size_t col = 0; r[col] != NULL; col++) touch(r[col], getssbsize(r[col], u, &cellsize));
+		tssb_hash h = hash_tssb(&u, 0, NULL, 0);
+		if (h.buckets != NULL) sink ^= find_tssb_row(&u, &h, copy, size % 8);
+		free(h.buckets);
+	}
+	release_tssb(&u);
+
+	memcpy(copy, data, size);
+	u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, copy, size, NULL, 0);
+	uint32_t *index = u.errreasonstr == NULL and u.rows * u.cols < size ? index_tssb32(&u, NULL, 0) : NULL;
+	if (index != NULL) for (size_t i = 0; i < u.rows * u.cols; i++) {
+		if (index[i] != 0) touch(u.source + index[i], getssbsize(u.source + index[i], u, &cellsize));
+	}
+	free(index);
+	release_tssb(&u);
+
+	// regular objects are indexed above, with a guard against huge claimed dimensions
+	memcpy(copy, data, size);
+	tssb_shared s = {.errreasonstr = err_not_a_valid_tssb};
+	if (is_indexed(copy, size)) s = prepare_tssb_indexed_addr(copy, size);
+	if (s.errreasonstr == NULL) for (size_t i = 0; i < s.u.rows * s.u.cols; i++) {
+		if (s.index[i] != 0) touch(s.u.source + s.index[i], getssbsize(s.u.source + s.index[i], s.u, &cellsize));
+	}
+	detach_tssb_shared(&s);
+	free(copy);
+}
+
+static void fuzz_packed(const uint8_t *data, size_t size) {
+	// above
+	// Compressed object is never written, so input can be used as is. Every row is fetched, so every block is
+	// decompressed, and cache of 2 blocks is reused many times.
+
+	size_t cellsize;
+	tssb_packed p = prepare_tssb_packed_addr(data, size, 2);
+	for (size_t row = 0; row < p.u.rows; row++) {
+		char **r = tssb_packed_row(&p, row);
+		if (r != NULL) for (size_t col = 0; r[col] != NULL; col++) touch(r[col], getssbsize(r[col], p.u, &cellsize));
+	}
+	release_tssb_packed(&p);
+}
+
+static bool resolver(void *ctx, const essb *e, uint32_t key, const void **data, size_t *size) {
+	// above
+	// Every key is replaced with its own name
+
+	*data = ESSB_RETRIEVE(*e, e->keys[key].record);
+	*size = - (int64_t) e->record_size[e->keys[key].record];
+	return true;
+}
+
+static void fuzz_essb(const uint8_t *data, size_t size) {
+	if (size < sizeof(struct essb_format)) return;
+	char *copy = duplicate(data, size); // malloc() result is aligned, unlike input of libFuzzer
+	if (copy == NULL) return;
+
+	// SOURCE_ADDR has no size, so caller is responsible for passing whole layout which is described by header. It
+	// may make sense in both byte orders, and then native one may be read after foreign guess, so both must fit
+	essb e = {.records = NULL};
+	const struct essb_format *format = (const void *) copy;
+	uint32_t amount = format->records_amount, total = format->records_total_size;
+	if (essb_layout(amount, total, SIZE_MAX) != UINT64_MAX and essb_layout(amount, total, size) == UINT64_MAX) goto refree;
+	amount = bswap32_priv_ssb(amount), total = bswap32_priv_ssb(total);
+	if (essb_layout(amount, total, SIZE_MAX) != UINT64_MAX and essb_layout(amount, total, size) == UINT64_MAX) goto refree;
+	if (check_essb(SOURCE_ADDR, copy) == 0) goto refree;
+
+	e = (essb) {.records = NULL};
+	if (parse_essb(&e, SOURCE_ADDR, copy, NULL) == false) goto refree;
+	for (uint32_t i = 0; i < e.records_amount; i++) {
+		touch(ESSB_RETRIEVE(e, i), e.record_size[i] < 0 ? - (int64_t) e.record_size[i] : e.record_size[i]);
+	}
+	if (hash_essb_keys(&e, NULL) and e.keys_amount > 0) {
+		uint32_t first = e.keys[0].record;
+		sink ^= find_essb_key(&e, ESSB_RETRIEVE(e, first), - (int64_t) e.record_size[first]);
+	}
+	size_t rendered = render_essb_size(&e, resolver, NULL);
+	if (rendered != SIZE_MAX) {
+		char *buffer = malloc(rendered ? rendered : 1);
+		if (buffer != NULL and render_essb_buffer(&e, resolver, NULL, buffer, rendered) == rendered) touch(buffer, rendered);
+		free(buffer);
+	}
+
+	refree:
+	release_essb(&e);
+	free(copy);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	fuzz_tssb(data, size);
+	fuzz_packed(data, size);
+	fuzz_essb(data, size);
+	return 0;
+}
+
+#if !defined(SSB_LIBFUZZER)
+#define MUTATIONS 200000
+
+static uint64_t xorshift(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static int replay(int amount, char **filenames) {
+	for (int i = 0; i < amount; i++) {
+		FILE *f = fopen(filenames[i], "rb");
+		if (f == NULL) {
+			printf("%s: %s\n", filenames[i], strerror(errno));
+			return EXIT_FAILURE;
+		}
+		static uint8_t buffer[1 << 20];
+		size_t got = fread(buffer, 1, sizeof(buffer), f);
+		fclose(f);
+		LLVMFuzzerTestOneInput(buffer, got);
+	}
+	printf("%d inputs replayed\n", amount);
+	return EXIT_SUCCESS;
+}
+
+static size_t build_seeds(uint8_t *tssb_seed, size_t tssb_capacity, uint8_t *essb_seed, uint8_t *foreign_seed,
+	size_t essb_capacity, size_t *essb_size, uint8_t *packed_seed, size_t *packed_size, uint8_t *pooled_seed,
+	size_t *pooled_size) {
+	// above
+	// Valid objects which are mutated by standalone fuzzer. ESSB seed is also converted to other byte order, so
+	// detection of byte order is fuzzed too, and TSSB seed is packed by 2 rows in block and built as pooled
+	// variant. Returns size of TSSB seed, or 0 on failure.
+
+	tssb_builder b = {0};
+	const char *words[] = {"hello", "world", "", "hi", "all", "sixteen bytes..."};
+	for (unsigned row = 0; row < 4; row++) {
+		add_tssb_row(&b);
+		for (unsigned col = 0; col <= row % 3; col++) add_tssb_cell(&b, words[(row + col) % 6], strlen(words[(row + col) % 6]));
+	}
+	size_t tssb_size = calculate_tssb_build(&b);
+	if (tssb_size > tssb_capacity or build_tssb(&b, tssb_seed, tssb_size) != tssb_size) tssb_size = 0;
+	b.options = TSSB_BUILD_POOLED;
+	*pooled_size = calculate_tssb_build(&b);
+	if (*pooled_size > tssb_capacity or build_tssb(&b, pooled_seed, *pooled_size) != *pooled_size) tssb_size = 0;
+	release_tssb_builder(&b);
+	tssb u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, tssb_seed, tssb_size, NULL, 0);
+	*packed_size = calculate_tssb_pack(&u, 2) <= tssb_capacity ? pack_tssb(&u, 2, packed_seed, tssb_capacity) : 0;
+	release_tssb(&u);
+	if (*packed_size == 0) return 0;
+
+	const char template[] = "First text{{1sttag}}SCND{{S}}{{ABCD EFG}}BEBRA{{1sttag}}{{z}}\n";
+	*essb_size = check_essb_template(template, strizeof(template), "{{", "}}");
+	essb e = {.records = NULL};
+	if (*essb_size > essb_capacity or compile_essb(&e, template, strizeof(template), "{{", "}}", essb_seed, *essb_size) == false) {
+		return 0;
+	}
+	memcpy(foreign_seed, essb_seed, *essb_size);
+	bswap32_bulk_priv_ssb(foreign_seed + strizeof(essb_signature_0), foreign_seed + strizeof(essb_signature_0), 2);
+	uint8_t *table = foreign_seed + ((uint8_t *) e.record_size - essb_seed);
+	bswap32_bulk_priv_ssb(table, table, e.records_amount);
+	release_essb(&e);
+	return tssb_size;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) return replay(argc - 1, argv + 1);
+
+	static uint8_t seeds[5][256] __attribute__((aligned(8)));
+	size_t sizes[5];
+	sizes[0] = build_seeds(seeds[0], sizeof(seeds[0]), seeds[1], seeds[2], sizeof(seeds[1]), sizes + 1, seeds[3], sizes + 3,
+		seeds[4], sizes + 4);
+	if (sizes[0] == 0) return printf("Can't build seeds\n"), EXIT_FAILURE;
+	sizes[2] = sizes[1];
+
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	uint8_t input[sizeof(seeds[0])];
+	for (unsigned i = 0; i < MUTATIONS; i++) {
+		unsigned seed = i % 5;
+		size_t size = sizes[seed];
+		memcpy(input, seeds[seed], size);
+		for (unsigned m = xorshift(&state) % 4 + 1; m > 0; m--) {
+			size_t at = xorshift(&state) % size;
+			switch (xorshift(&state) % 4) {
+			case 0: input[at] = (uint8_t) xorshift(&state); break; // random byte
+			case 1: input[at] = UCHAR_MAX; break; // newline sigils and huge sizes
+			case 2: input[at] ^= 0x80; break; // signs of essb sizes
+			case 3: size = at + 1; break; // truncation
+			}
+		}
+		LLVMFuzzerTestOneInput(input, size);
+	}
+	printf("%d mutations passed\n", MUTATIONS);
+	return EXIT_SUCCESS;
+}
+#endif // SSB_LIBFUZZER
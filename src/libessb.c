@@ -40,12 +40,24 @@
 #define ESSB_CALCULATE_RESIDUE(s) ((s).records_total_size % 4 ? 4 - (s).records_total_size % 4 : 0)
 #define ESSB_CALCULATE(structure) ((structure).records_total_size + ESSB_CALCULATE_RESIDUE(structure) + (structure).records_amount * sizeof(int32_t) * 2)
 #define ESSB_CALCULATE_FILE(structure) ((structure).records_total_size + ESSB_CALCULATE_RESIDUE(structure) + (structure).records_amount * sizeof(int32_t))
+#define ESSB_CALCULATE_MMAP(structure) ((structure).records_amount * sizeof(int32_t) * ((structure).flags & ESSB_FOREIGN ? 2 : 1))
+
+#define ESSB_OWN_RECORDS 0x1 // records (and tables after them) were allocated by library
+#define ESSB_OWN_SEEK    0x2 // record_seek was allocated by library apart from records
+#define ESSB_MAPPED      0x4 // records are pointing into file mapping
+#define ESSB_OWN_KEYS    0x8 // keys were allocated by library
+#define ESSB_OWN_HASH    0x10 // key_hash was allocated by library
+#define ESSB_FOREIGN     0x20 // counters and sizes are in byte order of other platform, so sizes are swapped by library
+#define ESSB_EITHER      0x40 // size of object is unknown and both byte orders are making sense, so guess is verified
 
 const char essb_signature_0[] = "SSBTEMPLATE0";
 
 const char err_not_a_valid_essb[] = "This is not a valid essb file.";
 const char err_invalid_arg[] = "Invalid argument(s).";
 const char err_not_supported[] = "This feature is not supported or disabled.";
+const char err_render_fail[] = "Key resolver has failed.";
+const char err_no_space[] = "Passed memory area is not enough for rendering result.";
+const char err_template_fail[] = "Template is empty, too big or has unterminated or empty key.";
 const char err_essb_reuse[] = "This essb object is already on use. If it's not, memset() it to zero before reuse.";
 
 struct essb_format {
@@ -55,17 +67,83 @@ struct essb_format {
 	char records[];
 };
 
-static bool check_signature(essb *e, const struct essb_format *format) {
-	if (format->records_amount == 0 or format->records_total_size == 0 or
-		memcmp(format->signature, essb_signature_0, strizeof(essb_signature_0)) != 0) {
+static uint64_t essb_layout(uint32_t amount, uint32_t total, size_t available) {
+	// above
+	// Size of file which is described by counters, or UINT64_MAX if counters are nonsense. Whole layout must be
+	// describable by uint32_t, which is returned by check_essb() (with header, for SOURCE_ADDR_INPLACE), and fit in
+	// _available_ bytes. Records must be addressable by int32_t record_seek, and that's also what makes sum check in
+	// parse() exact: sum which has wrapped around has bit 31 set, so it can't match total which fits in int32_t.
+
+	uint64_t layout = sizeof(struct essb_format) + total + (4 - total % 4) % 4 + amount * (uint64_t) sizeof(int32_t);
+	if (amount == 0 or total == 0 or total > INT32_MAX or
+		sizeof(struct essb_format) + total + 3ull + amount * (uint64_t) sizeof(int32_t) * 2 > UINT32_MAX or
+		layout > available) return UINT64_MAX;
+	return layout;
+}
+
+static bool check_essb_signature(essb *e, const struct essb_format *format, size_t available) {
+	// above
+	// Checks signature and detects byte order of producer by counters. _available_ is the size of file, or SIZE_MAX if
+	// it's unknown. If both orders are making sense, layout which is exactly as big as file wins. If size is unknown,
+	// the smaller layout is guessed and ESSB_EITHER is set, so choose_order() verifies guess by sizes before anything
+	// is written. Wrong guess is always caught by sum check in parse() anyway, so records are never misparsed.
+
+	if (memcmp(format->signature, essb_signature_0, strizeof(essb_signature_0)) != 0) {
+		e->errreasonstr = err_not_a_valid_essb;
+		return false;
+	}
+
+	uint32_t amount = format->records_amount, total = format->records_total_size;
+	uint64_t native = essb_layout(amount, total, available);
+	uint64_t foreign = essb_layout(bswap32_priv_ssb(amount), bswap32_priv_ssb(total), available);
+	if (native == UINT64_MAX and foreign == UINT64_MAX) {
 		e->errreasonstr = err_not_a_valid_essb;
 		return false;
 	}
+	bool swap = available == SIZE_MAX ? foreign < native : native != available and (foreign == available or native == UINT64_MAX);
+	e->flags &= ~(ESSB_FOREIGN | ESSB_EITHER);
+	if (available == SIZE_MAX and native != UINT64_MAX and foreign != UINT64_MAX) e->flags |= ESSB_EITHER;
+	if (swap) {
+		amount = bswap32_priv_ssb(amount);
+		total = bswap32_priv_ssb(total);
+		e->flags |= ESSB_FOREIGN;
+	}
 
-	e->records_amount = format->records_amount;
-	e->records_total_size = format->records_total_size;
+	e->records_amount = amount;
+	e->records_total_size = total;
 	return true;
 }
+static bool sizes_sum_up(const essb *e, const char *records) {
+	// above
+	// Read-only version of sum check from parse(), for sizes in byte order which is currently guessed.
+
+	const char *fly = records + e->records_total_size + ESSB_CALCULATE_RESIDUE(*e);
+	uint32_t total = 0, seen = 0;
+	for (uint32_t i = 0; i < e->records_amount; i++) {
+		uint32_t size;
+		memcpy(&size, fly + i * sizeof(size), sizeof(size));
+		if (e->flags & ESSB_FOREIGN) size = bswap32_priv_ssb(size);
+		seen |= total;
+		total += (int32_t) size < 0 ? - size : size;
+	}
+	return (total | (seen & 0x80000000u)) == e->records_total_size;
+}
+
+static void choose_order(essb *e, const char *records) {
+	// above
+	// Resolves ESSB_EITHER guess of check_essb_signature(). The smaller layout is checked first, so a valid object
+	// of that layout is never read beyond its end. If sizes of foreign guess don't sum up, object is taken as
+	// native one. The opposite is not done: native object with broken sizes would be read as much larger foreign
+	// layout then, far beyond its end, so parse() refuses it instead.
+
+	if ((e->flags & ESSB_EITHER) == 0) return;
+	e->flags &= ~ESSB_EITHER;
+	if ((e->flags & ESSB_FOREIGN) == 0 or sizes_sum_up(e, records)) return;
+	e->records_amount = bswap32_priv_ssb(e->records_amount);
+	e->records_total_size = bswap32_priv_ssb(e->records_total_size);
+	e->flags ^= ESSB_FOREIGN;
+}
+
 #if defined(SSB_POSIX_0)
 static int check_file_signature(essb *e, const void *p) {
 
@@ -89,7 +167,14 @@ static int check_file_signature(essb *e, const void *p) {
 		return POSIX_FAILURE_RETVAL;
 	}
 
-	if (check_signature(e, &buffer) == false) {
+	size_t filesize;
+	if (fstat_getsize(fd, &filesize) < 0) {
+		e->errreasonstr = strerror(errno);
+		close(fd);
+		return POSIX_FAILURE_RETVAL;
+	}
+
+	if (check_essb_signature(e, &buffer, filesize) == false) { // layout fits in file, so mapping is never touched beyond it
 		close(fd);
 		return POSIX_FAILURE_RETVAL;
 	}
@@ -98,17 +183,40 @@ static int check_file_signature(essb *e, const void *p) {
 }
 #endif // SSB_POSIX_0
 
-static void parse(essb *e) {
+static bool parse(essb *e, int32_t *seek, int32_t *sizes) {
+	// above
+	// Locate table with sizes and fill record_seek table. If _seek_ is NULL, record_seek table is placed right
+	// after table with sizes, so that memory must be writable.
+	// Sizes must sum up exactly to records_total_size, otherwise some record is pointing outside of records. Sum is
+	// returned by prefix sum kernel anyway, so the check costs a single comparison.
+	// Sizes of foreign file are swapped by one bulk pass: in place if _sizes_ is NULL, so that memory must be
+	// writable too, or into _sizes_ otherwise, leaving records untouched.
+
 	char *fly = e->records + e->records_total_size;
 	fly += ESSB_CALCULATE_RESIDUE(*e);
-	e->record_size = (void *) fly;
+	e->record_size = sizes != NULL ? sizes : (void *) fly;
+	if (e->flags & ESSB_FOREIGN) bswap32_bulk_priv_ssb(e->record_size, fly, e->records_amount);
 	fly += e->records_amount * sizeof(int32_t);
-	e->record_seek = (void *) fly;
-	int32_t total = 0;
-	for (unsigned i = 0; i < e->records_amount; i++) {
-		e->record_seek[i] = total;
-		total += e->record_size[i] < 0 ? - e->record_size[i] : e->record_size[i];
+	e->record_seek = seek != NULL ? seek : (void *) fly;
+	uint32_t total = abs_prefix_sum_priv_ssb(e->record_size, e->record_seek, e->records_amount);
+	if (SSB_MALFORMED(total != e->records_total_size)) {
+		if (e->flags & ESSB_FOREIGN and sizes == NULL) { // wrong guess leaves no trace
+			bswap32_bulk_priv_ssb(e->record_size, e->record_size, e->records_amount);
+		}
+		e->errreasonstr = err_not_a_valid_essb;
+		return false;
 	}
+	return true;
+}
+
+static bool reject_essb(essb *e) {
+	// above
+	// Releases everything that parse_essb() has obtained for malformed essb, but keeps the reason.
+
+	const char *reason = e->errreasonstr;
+	release_essb(e);
+	e->errreasonstr = reason;
+	return false;
 }
 
 uint32_t check_essb(source_type t, const void *source) {
@@ -119,10 +227,16 @@ uint32_t check_essb(source_type t, const void *source) {
 	case SOURCE_FILE:
 		close(check_file_signature(&e, source));
 		return ESSB_CALCULATE(e);
+	case SOURCE_MMAP:
+		close(check_file_signature(&e, source));
+		return ESSB_CALCULATE_MMAP(e);
 	case SOURCE_ADDR:
-	case SOURCE_ADDR_INPLACE:
-		check_signature(&e, source);
+		if (check_essb_signature(&e, source, SIZE_MAX)) choose_order(&e, ((const struct essb_format *) source)->records);
 		return ESSB_CALCULATE(e);
+	case SOURCE_ADDR_INPLACE: // records are staying right after header, so it's part of stackmem too
+		if (check_essb_signature(&e, source, SIZE_MAX) == false) return 0;
+		choose_order(&e, ((const struct essb_format *) source)->records);
+		return sizeof(struct essb_format) + ESSB_CALCULATE(e);
 	case SOURCE_WEB:
 	default:
 		return 0;
@@ -165,16 +279,48 @@ bool parse_essb(essb *e, source_type t, const void *source, void *stackmem) {
 			}
 			return false;
 		}
-		parse(e);
+		close(fd);
+		if (stackmem == NULL) e->flags |= ESSB_OWN_RECORDS;
+		if (parse(e, NULL, NULL) == false) return reject_essb(e);
+		return true;
+#endif // SSB_POSIX_0
+		e->errreasonstr = err_not_supported;
+		return false;
+	case SOURCE_MMAP:
+#if defined(SSB_POSIX_0)
+		fd = check_file_signature(e, format);
+		if (fd < 0) return false;
+		void *mapping = mmap(NULL, sizeof(struct essb_format) + ESSB_CALCULATE_FILE(*e), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) {
+			e->errreasonstr = strerror(errno);
+			return false;
+		}
+		int32_t *seek = stackmem;
+		if (seek == NULL) {
+			seek = malloc(ESSB_CALCULATE_MMAP(*e));
+			if (seek == NULL) {
+				e->errreasonstr = strerror(errno);
+				munmap(mapping, sizeof(struct essb_format) + ESSB_CALCULATE_FILE(*e));
+				return false;
+			}
+			e->flags |= ESSB_OWN_SEEK;
+		}
+		e->flags |= ESSB_MAPPED;
+		e->records = ((struct essb_format *) mapping)->records;
+		// foreign sizes are swapped right behind record_seek table, so mapping stays shared
+		if (parse(e, seek, e->flags & ESSB_FOREIGN ? seek + e->records_amount : NULL) == false) return reject_essb(e);
 		return true;
 #endif // SSB_POSIX_0
 		e->errreasonstr = err_not_supported;
 		return false;
 	case SOURCE_ADDR:
-		if (check_signature(e, format) == false) return false;
+		if (check_essb_signature(e, format, SIZE_MAX) == false) return false;
+		choose_order(e, format->records);
 		if (stackmem) e->records = stackmem; else e->records = malloc(ESSB_CALCULATE(*e));
-		memcpy(e->records, format->records, ESSB_CALCULATE(*e));
-		parse(e);
+		if (stackmem == NULL) e->flags |= ESSB_OWN_RECORDS;
+		memcpy(e->records, format->records, ESSB_CALCULATE_FILE(*e));
+		if (parse(e, NULL, NULL) == false) return reject_essb(e);
 		return true;
 
 	case SOURCE_ADDR_INPLACE:
@@ -182,9 +328,15 @@ bool parse_essb(essb *e, source_type t, const void *source, void *stackmem) {
 			e->errreasonstr = err_invalid_arg;
 			return false;
 		}
-		if (check_signature(e, format) == false) return false;
-		e->records = stackmem;
-		parse(e);
+		if (check_essb_signature(e, format, SIZE_MAX) == false) return false;
+		e->records = ((struct essb_format *) stackmem)->records;
+		choose_order(e, e->records);
+		if (parse(e, NULL, NULL) == false) return reject_essb(e);
+		if (e->flags & ESSB_FOREIGN) { // sizes are native now, so counters must be too, otherwise next parse swaps again
+			((struct essb_format *) stackmem)->records_amount = e->records_amount;
+			((struct essb_format *) stackmem)->records_total_size = e->records_total_size;
+			e->flags &= ~ESSB_FOREIGN;
+		}
 		return true;
 
 	case SOURCE_WEB:
@@ -197,5 +349,303 @@ bool parse_essb(essb *e, source_type t, const void *source, void *stackmem) {
 	}
 }
 
+static bool emit_record(essb *e, const char *p, size_t size, bool key) {
+	// above
+	// Counts record; also copies it and stores its size if records and record_size are already placed.
+
+	if (size > INT32_MAX or e->records_amount == INT32_MAX or size > (size_t) INT32_MAX - e->records_total_size) return false;
+	if (e->records != NULL) {
+		memcpy(e->records + e->records_total_size, p, size);
+		e->record_size[e->records_amount] = key ? -(int32_t) size : (int32_t) size;
+	}
+	e->records_amount++;
+	e->records_total_size += size;
+	return true;
+}
+
+static bool scan_template(essb *e, const char *text, size_t size, const char *open, const char *close) {
+	// above
+	// Splits template to static records and keys. Static text between adjacent keys is empty, so it's not a record.
+
+	const char *end = text + size;
+	size_t open_size = strlen(open), close_size = strlen(close);
+	e->records_amount = 0;
+	e->records_total_size = 0;
+	while (text < end) {
+		const char *key = find_substring_priv_ssb(text, end, open, open_size);
+		if (key == NULL) key = end;
+		if (key > text and emit_record(e, text, key - text, false) == false) return false;
+		if (key == end) break;
+		key += open_size;
+		const char *key_end = find_substring_priv_ssb(key, end, close, close_size);
+		if (key_end == NULL or key_end == key) return false;
+		if (emit_record(e, key, key_end - key, true) == false) return false;
+		text = key_end + close_size;
+	}
+	return e->records_amount > 0;
+}
+
+size_t check_essb_template(const void *text, size_t size, const char *open, const char *close) {
+	if (text == NULL or open == NULL or close == NULL or *open == '\0' or *close == '\0') return 0;
+	essb e = {.records = NULL};
+	if (scan_template(&e, text, size, open, close) == false) return 0;
+	return sizeof(struct essb_format) + ESSB_CALCULATE(e);
+}
+
+bool compile_essb(essb *e, const void *text, size_t size, const char *open, const char *close, void *buffer, size_t bufsize) {
+	if (e == NULL) return false;
+	if (text == NULL or buffer == NULL or open == NULL or close == NULL or *open == '\0' or *close == '\0') {
+		e->errreasonstr = err_invalid_arg;
+		return false;
+	}
+	if (e->records) {
+		e->errreasonstr = err_essb_reuse;
+		return false;
+	}
+
+	// first pass only counts, so layout is known. Second one fills buffer, which is parsed in place after that
+	essb counted = {.records = NULL};
+	if (scan_template(&counted, text, size, open, close) == false) {
+		e->errreasonstr = err_template_fail;
+		return false;
+	}
+	if (bufsize < sizeof(struct essb_format) + ESSB_CALCULATE(counted)) {
+		e->errreasonstr = err_no_space;
+		return false;
+	}
+
+	struct essb_format *format = buffer;
+	memcpy(format->signature, essb_signature_0, strizeof(essb_signature_0));
+	format->records_amount = counted.records_amount;
+	format->records_total_size = counted.records_total_size;
+	memset(format->records + counted.records_total_size, 0, ESSB_CALCULATE_RESIDUE(counted));
+	counted.record_size = (void *) (format->records + counted.records_total_size + ESSB_CALCULATE_RESIDUE(counted));
+	counted.records = format->records;
+	scan_template(&counted, text, size, open, close);
+
+	// layout is native for sure, so byte order is not guessed here
+	e->errreasonstr = NULL;
+	e->records_amount = counted.records_amount;
+	e->records_total_size = counted.records_total_size;
+	e->records = format->records;
+	if (parse(e, NULL, NULL) == false) return reject_essb(e);
+	return true;
+}
+
+static uint32_t count_keys(const essb *e) {
+	uint32_t amount = 0;
+	for (uint32_t i = 0; i < e->records_amount; i++) amount += e->record_size[i] < 0;
+	return amount;
+}
+
+uint32_t check_essb_keys(const essb *e) {
+	if (e == NULL or e->record_size == NULL) return 0;
+	return count_keys(e) * sizeof(essb_key);
+}
+
+bool index_essb_keys(essb *e, void *stackmem) {
+	if (e == NULL) return false;
+	if (e->record_size == NULL or e->keys != NULL) {
+		e->errreasonstr = err_invalid_arg;
+		return false;
+	}
+
+	uint32_t amount = count_keys(e);
+	essb_key *keys = stackmem;
+	if (keys == NULL and amount > 0) {
+		keys = malloc(amount * sizeof(essb_key));
+		if (keys == NULL) {
+			e->errreasonstr = strerror(errno);
+			return false;
+		}
+		e->flags |= ESSB_OWN_KEYS;
+	}
+
+	uint32_t span_seek = 0, k = 0;
+	for (uint32_t i = 0; i < e->records_amount; i++) {
+		if (e->record_size[i] >= 0) continue;
+		keys[k].record = i;
+		keys[k].span_seek = span_seek;
+		keys[k].span_size = e->record_seek[i] - span_seek;
+		span_seek = e->record_seek[i] - e->record_size[i];
+		k++;
+	}
+	e->keys = keys;
+	e->keys_amount = amount;
+	return true;
+}
+
+static uint32_t hash_buckets(uint32_t keys_amount) {
+	// above
+	// Amount of buckets is power of two which keeps load factor not above 0.5
+
+	uint32_t buckets = 2;
+	while (buckets < keys_amount * 2ull) buckets *= 2;
+	return buckets;
+}
+
+uint32_t check_essb_hash(const essb *e) {
+	if (e == NULL) return 0;
+	return (hash_buckets(e->keys_amount) + e->keys_amount) * sizeof(uint32_t);
+}
+
+static inline bool same_key(const essb *e, uint32_t key, const void *name, size_t size) {
+	uint32_t record = e->keys[key].record;
+	return (size_t) - (int64_t) e->record_size[record] == size and memcmp(ESSB_RETRIEVE(*e, record), name, size) == 0;
+}
+
+bool hash_essb_keys(essb *e, void *stackmem) {
+	if (e == NULL) return false;
+	if (e->key_hash != NULL) {
+		e->errreasonstr = err_invalid_arg;
+		return false;
+	}
+	if (e->keys == NULL and e->keys_amount == 0 and index_essb_keys(e, NULL) == false) return false;
+
+	uint32_t buckets = hash_buckets(e->keys_amount);
+	uint32_t *table = stackmem;
+	if (table == NULL) {
+		table = malloc(check_essb_hash(e));
+		if (table == NULL) {
+			e->errreasonstr = strerror(errno);
+			return false;
+		}
+		e->flags |= ESSB_OWN_HASH;
+	}
+	memset(table, 0, check_essb_hash(e));
+	uint32_t *next = table + buckets;
+
+	for (uint32_t k = e->keys_amount; k-- > 0;) { // backwards, so chains are in order of appearance
+		uint32_t record = e->keys[k].record;
+		const void *name = ESSB_RETRIEVE(*e, record);
+		size_t size = - (int64_t) e->record_size[record];
+		uint32_t b = hash_priv_ssb(name, size) & (buckets - 1);
+		while (table[b] != 0 and same_key(e, table[b] - 1, name, size) == false) b = (b + 1) & (buckets - 1);
+		next[k] = table[b];
+		table[b] = k + 1;
+	}
+
+	e->key_hash = table;
+	e->key_hash_size = buckets;
+	return true;
+}
+
+uint32_t find_essb_key(const essb *e, const void *name, size_t size) {
+	if (e->key_hash == NULL) return ESSB_NO_KEY;
+	uint32_t mask = e->key_hash_size - 1;
+	uint32_t b = hash_priv_ssb(name, size) & mask;
+	while (e->key_hash[b] != 0) {
+		if (same_key(e, e->key_hash[b] - 1, name, size)) return e->key_hash[b] - 1;
+		b = (b + 1) & mask;
+	}
+	return ESSB_NO_KEY;
+}
+
+static inline bool prepare_render(essb *e) {
+	if (e->record_size == NULL) {
+		e->errreasonstr = err_invalid_arg;
+		return false;
+	}
+	if (e->keys != NULL or e->keys_amount != 0) return true;
+	return index_essb_keys(e, NULL);
+}
+
+#if defined(SSB_POSIX_0)
+size_t render_essb_iovec(essb *e, essb_resolver resolver, void *ctx, struct iovec *iov, size_t iovcnt) {
+	if (e == NULL) return SIZE_MAX;
+	if (prepare_render(e) == false) return SIZE_MAX;
+
+	size_t used = 0;
+	for (uint32_t k = 0; k < e->keys_amount; k++) {
+		const essb_key *key = e->keys + k;
+		if (key->span_size > 0) {
+			if (used == iovcnt) goto no_space;
+			iov[used].iov_base = e->records + key->span_seek;
+			iov[used++].iov_len = key->span_size;
+		}
+		const void *data;
+		size_t size;
+		if (resolver(ctx, e, k, &data, &size) == false) {
+			e->errreasonstr = err_render_fail;
+			return SIZE_MAX;
+		}
+		if (size > 0) {
+			if (used == iovcnt) goto no_space;
+			iov[used].iov_base = (void *) data;
+			iov[used++].iov_len = size;
+		}
+	}
+	uint32_t tail = ESSB_TAIL_SEEK(*e);
+	if (tail < e->records_total_size) {
+		if (used == iovcnt) goto no_space;
+		iov[used].iov_base = e->records + tail;
+		iov[used++].iov_len = e->records_total_size - tail;
+	}
+	return used;
+
+	no_space:
+	e->errreasonstr = err_no_space;
+	return SIZE_MAX;
+}
+#endif // SSB_POSIX_0
+
+size_t render_essb_size(essb *e, essb_resolver resolver, void *ctx) {
+	if (e == NULL) return SIZE_MAX;
+	if (prepare_render(e) == false) return SIZE_MAX;
+
+	size_t total = e->records_total_size;
+	for (uint32_t k = 0; k < e->keys_amount; k++) {
+		const void *data;
+		size_t size;
+		if (resolver(ctx, e, k, &data, &size) == false) {
+			e->errreasonstr = err_render_fail;
+			return SIZE_MAX;
+		}
+		total = total + size + e->record_size[e->keys[k].record]; // key is replaced with substitution
+	}
+	return total;
+}
+
+size_t render_essb_buffer(essb *e, essb_resolver resolver, void *ctx, void *buffer, size_t size) {
+	if (e == NULL) return SIZE_MAX;
+	if (prepare_render(e) == false) return SIZE_MAX;
+
+	char *fly = buffer, *end = fly + size;
+	for (uint32_t k = 0; k < e->keys_amount; k++) {
+		const essb_key *key = e->keys + k;
+		if ((size_t) (end - fly) < key->span_size) goto no_space;
+		memcpy(fly, e->records + key->span_seek, key->span_size);
+		fly += key->span_size;
+		const void *data;
+		size_t datasize;
+		if (resolver(ctx, e, k, &data, &datasize) == false) {
+			e->errreasonstr = err_render_fail;
+			return SIZE_MAX;
+		}
+		if ((size_t) (end - fly) < datasize) goto no_space;
+		memcpy(fly, data, datasize);
+		fly += datasize;
+	}
+	uint32_t tail = ESSB_TAIL_SEEK(*e);
+	if ((size_t) (end - fly) < e->records_total_size - tail) goto no_space;
+	memcpy(fly, e->records + tail, e->records_total_size - tail);
+	fly += e->records_total_size - tail;
+	return fly - (char *) buffer;
+
+	no_space:
+	e->errreasonstr = err_no_space;
+	return SIZE_MAX;
+}
+
+void release_essb(essb *e) {
+	if (e->flags & ESSB_MAPPED) {
+		munmap(e->records - offsetof(struct essb_format, records), sizeof(struct essb_format) + ESSB_CALCULATE_FILE(*e));
+	}
+	if (e->flags & ESSB_OWN_SEEK) free(e->record_seek);
+	if (e->flags & ESSB_OWN_KEYS) free(e->keys);
+	if (e->flags & ESSB_OWN_HASH) free(e->key_hash);
+	if (e->flags & ESSB_OWN_RECORDS) free(e->records);
+	memset(e, 0, sizeof(essb));
+}
 
 #endif // PROTECTOR_LIBESSB_C
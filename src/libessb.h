@@ -26,6 +26,12 @@
 #ifndef PROTECTOR_LIBESSB_H
 #define PROTECTOR_LIBESSB_H
 
+typedef struct {
+	uint32_t record; // number of key record
+	uint32_t span_seek; // static records between previous key (or beginning) and this key are one contiguous span.
+	uint32_t span_size; // That's where it begins and how much bytes it takes. Size may be zero.
+} essb_key;
+
 typedef struct {
 	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
 	char *records;
@@ -33,11 +39,19 @@ typedef struct {
 	uint32_t records_total_size;
 	int32_t *record_size;
 	int32_t *record_seek;
+	uint32_t keys_amount; // amount of keys, available after index_essb_keys()
+	essb_key *keys; // keys only, in order of appearance, available after index_essb_keys()
+	uint32_t *key_hash; // hash table for find_essb_key(), available after hash_essb_keys(). Must not be used by user
+	uint32_t key_hash_size; // amount of buckets in that hash table. Must not be used by user
+	unsigned flags; // how records and record_seek were obtained, so release_essb() knows what to do with them. Must not be used by user
 } essb;
 
 #define ESSB_RETRIEVE(essb_object, number) ((essb_object).records+(essb_object).record_seek[number])
 
-typedef enum {SOURCE_FILE, SOURCE_ADDR, SOURCE_ADDR_INPLACE, SOURCE_WEB} source_type;
+#ifndef SSB_SOURCE_TYPE
+#define SSB_SOURCE_TYPE
+typedef enum {SOURCE_FILE, SOURCE_ADDR, SOURCE_ADDR_INPLACE, SOURCE_WEB, SOURCE_MMAP} source_type;
+#endif
 
 bool parse_essb(essb *e, source_type t, const void *source, void *stackmem);
 // above
@@ -51,13 +65,114 @@ bool parse_essb(essb *e, source_type t, const void *source, void *stackmem);
 // If SOURCE_WEB:          Just like SOURCE_FILE, but instead of reading from file, attempt to download
 //                         template from http or https resource. None of file will be written, library
 //                         will attempt to use as less memory as possible.
+// If SOURCE_MMAP:         Just like SOURCE_FILE, but file is mapped read-only and shared instead of reading.
+//                         Records and sizes are pointing straight into mapping, so only record_seek table
+//                         is allocated (or placed to _stackmem_, if passed). Sizes of file in other byte order
+//                         are swapped right after record_seek table, that's why check_essb() returns twice as
+//                         much for such file.
 // All parsing results are available through essb structure, which must be zeroed and it's address must
 // be passed to parse_essb()
+// If sizes of records don't sum up to records_total_size, nothing is parsed and everything is released. Memory
+// area behind SOURCE_ADDR and SOURCE_ADDR_INPLACE must contain whole layout which is described by its header.
+// Size of that area is unknown, so if header is making sense in both byte orders, the smaller layout is tried
+// first, and native one is taken if sizes don't sum up there. Use check_essb() to see which one it is. Foreign
+// object whose header describes even smaller native layout can't be told apart from malformed one that way,
+// load such object from file.
 //
-// If you want to know how much memory do you need to pass for _stackmem_, use check_essb() for that
+// If you want to know how much memory do you need to pass for _stackmem_, use check_essb() for that. For
+// SOURCE_ADDR_INPLACE it's the size of whole area, header included, which is bigger than the object itself
+// When you are done with parsed data, use release_essb()
 
 uint32_t check_essb(source_type t, const void *source);
 // above
-// evaluates reading from source just to retrieve amount of bytes that you'll need for stackmem memory
+// evaluates reading from source just to retrieve amount of bytes that you'll need for stackmem memory. For
+// SOURCE_ADDR_INPLACE that's the whole area which is passed as both _source_ and _stackmem_, including header of
+// object, just like check_essb_template() counts it. Returns 0 on failure.
+
+size_t check_essb_template(const void *text, size_t size, const char *open, const char *close);
+// above
+// Retrieve amount of bytes that you'll need for _buffer_ of compile_essb(), or 0 if template can't be compiled.
+
+bool compile_essb(essb *e, const void *text, size_t size, const char *open, const char *close, void *buffer, size_t bufsize);
+// above
+// Compiles text template, where keys are placed between _open_ and _close_ delimiters (e.g. "{{" and "}}"), to
+// SSBTEMPLATE0 layout in _buffer_ and parses it in place, just like parse_essb() with SOURCE_ADDR_INPLACE does.
+// _buffer_ must be aligned to 4 bytes. It begins with regular ESSB file (header, records, residue and sizes),
+// so it can be saved and parsed later. Release it with release_essb(), _buffer_ stays untouched.
+
+uint32_t check_essb_keys(const essb *e);
+// above
+// Retrieve amount of bytes that you'll need for stackmem memory for index_essb_keys()
+
+bool index_essb_keys(essb *e, void *stackmem);
+// above
+// Optional step after parse_essb(), which fills keys array. Every element tells which record is a key and where
+// static span before it is located, so rendering loop can iterate over keys only, instead of every record:
+// emit span, substitute key, repeat; then emit static tail (see ESSB_TAIL_SEEK).
+// If _stackmem_ is NULL, keys array is allocated and it will be freed by release_essb().
+
+#define ESSB_TAIL_SEEK(essb_object) ((essb_object).keys_amount ? \
+	(essb_object).keys[(essb_object).keys_amount - 1].span_seek + (essb_object).keys[(essb_object).keys_amount - 1].span_size - \
+	(essb_object).record_size[(essb_object).keys[(essb_object).keys_amount - 1].record] : 0)
+// above
+// Static records after the last key are one contiguous span too. That's where it begins. It ends at records_total_size.
+
+uint32_t check_essb_hash(const essb *e);
+// above
+// Retrieve amount of bytes that you'll need for stackmem memory for hash_essb_keys(). Available after index_essb_keys()
+
+bool hash_essb_keys(essb *e, void *stackmem);
+// above
+// Optional step after index_essb_keys() (it's called by this function if it wasn't done before). Builds hash table
+// which maps bytes of key to numbers of elements in keys array, so binding values to keys is O(1) per key.
+// If _stackmem_ is NULL, hash table is allocated and it will be freed by release_essb().
+
+#define ESSB_NO_KEY UINT32_MAX
+
+uint32_t find_essb_key(const essb *e, const void *name, size_t size);
+// above
+// Returns number of first element in keys array which has given name, or ESSB_NO_KEY.
+
+#define ESSB_NEXT_KEY(essb_object, key) ((essb_object).key_hash[(essb_object).key_hash_size + (key)] - 1)
+// above
+// Same key may appear in template several times. Returns number of next element in keys array with same name as
+// _key_ element has, or ESSB_NO_KEY. Example:
+// for (uint32_t k = find_essb_key(&e, "title", 5); k != ESSB_NO_KEY; k = ESSB_NEXT_KEY(e, k)) values[k] = title;
+
+typedef bool (*essb_resolver)(void *ctx, const essb *e, uint32_t key, const void **data, size_t *size);
+// above
+// Callback for render_essb_*() family, which is called for every key. _key_ is number of element in keys array,
+// so key itself is ESSB_RETRIEVE(*e, e->keys[key].record) and its size is -e->record_size[e->keys[key].record].
+// Put address and size of substitution to *data and *size. Substitution must stay valid until you're done with
+// rendering result. Return false to abort rendering.
+
+#define ESSB_CALCULATE_IOVEC(essb_object) (2 * (size_t) (essb_object).keys_amount + 1)
+// above
+// Maximum amount of iovec elements that render_essb_iovec() may use. Available after index_essb_keys().
+
+struct iovec;
+
+size_t render_essb_iovec(essb *e, essb_resolver resolver, void *ctx, struct iovec *iov, size_t iovcnt);
+// above
+// Renders template without copying anything: iov is filled with static spans (adjacent static records are merged
+// to one span) and substitutions of keys, so result can be passed to single writev() call. Empty spans are skipped.
+// Keys index is built by index_essb_keys(e, NULL) if it wasn't done before.
+// Returns amount of used iov elements (0 if result is empty), or SIZE_MAX if iovcnt is not enough or resolver has
+// failed (errreasonstr is set).
+
+size_t render_essb_size(essb *e, essb_resolver resolver, void *ctx);
+// above
+// Calculates exact amount of bytes of rendering result, so you can prepare buffer for render_essb_buffer().
+// Returns SIZE_MAX if something went wrong.
+
+size_t render_essb_buffer(essb *e, essb_resolver resolver, void *ctx, void *buffer, size_t size);
+// above
+// Renders template into single buffer. Resolver is expected to return same substitutions as during
+// render_essb_size() call. Returns amount of written bytes, or SIZE_MAX if buffer is not enough or resolver failed.
+
+void release_essb(essb *e);
+// above
+// Frees (or unmaps) everything that was allocated (or mapped) by parse_essb(). Memory that you were passed
+// as stackmem stays untouched. After that essb object is zeroed and can be used again.
 
 #endif // PROTECTOR_LIBESSB_H
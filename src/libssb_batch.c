@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_BATCH_C
+#define PROTECTOR_LIBSSB_BATCH_C
+
+#include <libtssb.c>
+#include <libessb.c>
+#include <libssb_batch.h>
+#include <pthread.h>
+
+#if defined(SSB_POSIX_0)
+#include <dirent.h>
+#endif
+
+struct batch_queue {
+	ssb_loaded *files;
+	size_t amount;
+	size_t next; // number of next file which is not taken by any thread yet
+};
+
+static void load_file(ssb_loaded *f) {
+	// above
+	// Most files are TSSB, so it's tried first. Only ESSB files pay for failed attempt.
+
+	f->u = prepare_tssb(f->filename, NULL, 0);
+	if (f->u.errreasonstr == NULL) {
+		f->table = parse_tssb(&f->u);
+		f->errreasonstr = f->u.errreasonstr;
+		return;
+	}
+	if (f->u.errreasonstr != err_not_a_valid_tssb) {
+		f->errreasonstr = f->u.errreasonstr;
+		return;
+	}
+
+	release_tssb(&f->u);
+	f->u.errreasonstr = NULL;
+	f->is_essb = true;
+	if (parse_essb(&f->e, SOURCE_FILE, f->filename, NULL) == false) f->errreasonstr = f->e.errreasonstr;
+}
+
+static void *batch_worker(void *arg) {
+	// above
+	// Every thread takes next file until there are none. Some files are much bigger than others, so that's
+	// better than splitting list to equal parts.
+
+	struct batch_queue *q = arg;
+	for (;;) {
+		size_t taken = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED);
+		if (taken >= q->amount) return NULL;
+		load_file(q->files + taken);
+	}
+}
+
+static void run_batch(ssb_batch *b, size_t threads) {
+	if (threads == 0) {
+#if defined(SSB_POSIX_0) && defined(_SC_NPROCESSORS_ONLN)
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (size_t) online : 1;
+#else
+		threads = 1;
+#endif
+	}
+	if (threads > b->amount) threads = b->amount;
+
+	struct batch_queue q = {.files = b->files, .amount = b->amount, .next = 0};
+	pthread_t *workers = threads > 1 ? malloc((threads - 1) * sizeof(pthread_t)) : NULL;
+	size_t started = 0;
+	if (workers != NULL) {
+		while (started < threads - 1 and pthread_create(workers + started, NULL, batch_worker, &q) == 0) started++;
+	}
+	batch_worker(&q); // if threads can't be created, everything is loaded right here
+	for (size_t i = 0; i < started; i++) pthread_join(workers[i], NULL);
+	free(workers);
+}
+
+ssb_batch load_ssb_batch(const char * const *filenames, size_t amount, size_t threads) {
+	ssb_batch b = {.errreasonstr = NULL};
+	if (filenames == NULL or amount == 0) {
+		b.errreasonstr = err_invalid_arg;
+		return b;
+	}
+
+	b.files = calloc(amount, sizeof(ssb_loaded));
+	if (b.files == NULL) {
+		b.errreasonstr = strerror(errno);
+		return b;
+	}
+	b.amount = amount;
+	for (size_t i = 0; i < amount; i++) {
+		size_t length = strlen(filenames[i]);
+		b.files[i].filename = malloc(length + 1);
+		if (b.files[i].filename == NULL) {
+			b.errreasonstr = strerror(errno);
+			release_ssb_batch(&b);
+			return b;
+		}
+		memcpy(b.files[i].filename, filenames[i], length + 1);
+	}
+
+	run_batch(&b, threads);
+	return b;
+}
+
+static int compare_names(const void *a, const void *b) {
+	return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+ssb_batch load_ssb_directory(const char *directory, size_t threads) {
+	ssb_batch b = {.errreasonstr = NULL};
+#if defined(SSB_POSIX_0)
+	if (directory == NULL) {
+		b.errreasonstr = err_invalid_arg;
+		return b;
+	}
+	DIR *d = opendir(directory);
+	if (d == NULL) {
+		b.errreasonstr = strerror(errno);
+		return b;
+	}
+
+	char **names = NULL;
+	size_t amount = 0, capacity = 0, length = strlen(directory);
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL) {
+		if (entry->d_name[0] == '.') continue;
+		if (amount == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			char **grown = realloc(names, capacity * sizeof(char *));
+			if (grown == NULL) goto nomem;
+			names = grown;
+		}
+		size_t namelength = strlen(entry->d_name);
+		char *path = malloc(length + namelength + 2);
+		if (path == NULL) goto nomem;
+		memcpy(path, directory, length);
+		path[length] = '/';
+		memcpy(path + length + 1, entry->d_name, namelength + 1);
+		names[amount++] = path;
+	}
+	closedir(d);
+
+	if (amount == 0) {
+		b.errreasonstr = err_invalid_arg;
+		free(names);
+		return b;
+	}
+	qsort(names, amount, sizeof(char *), compare_names);
+	b.files = calloc(amount, sizeof(ssb_loaded));
+	if (b.files == NULL) {
+		b.errreasonstr = strerror(errno);
+		for (size_t i = 0; i < amount; i++) free(names[i]);
+		free(names);
+		return b;
+	}
+	b.amount = amount;
+	for (size_t i = 0; i < amount; i++) b.files[i].filename = names[i];
+	free(names);
+
+	run_batch(&b, threads);
+	return b;
+
+	nomem:
+	b.errreasonstr = strerror(errno);
+	closedir(d);
+	for (size_t i = 0; i < amount; i++) free(names[i]);
+	free(names);
+	return b;
+#endif // SSB_POSIX_0
+	b.errreasonstr = err_not_supported;
+	return b;
+}
+
+void release_ssb_batch(ssb_batch *b) {
+	for (size_t i = 0; i < b->amount; i++) {
+		release_tssb(&b->files[i].u);
+		release_essb(&b->files[i].e);
+		free(b->files[i].filename);
+	}
+	free(b->files);
+	memset(b, 0, sizeof(ssb_batch));
+}
+
+#endif // PROTECTOR_LIBSSB_BATCH_C
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_BATCH_H
+#define PROTECTOR_LIBSSB_BATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "libtssb.h"
+#include "libessb.h"
+
+typedef struct {
+	const char *errreasonstr; // NULL if file is loaded, otherwise reason why it's not
+	char *filename;
+	bool is_essb; // which of objects below is filled
+	tssb u; // prepared TSSB object
+	char ***table; // and its table
+	essb e; // parsed ESSB object
+} ssb_loaded;
+
+typedef struct {
+	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
+	ssb_loaded *files; // one element for every file, in same order as filenames were passed (or sorted by name)
+	size_t amount;
+} ssb_batch;
+
+ssb_batch load_ssb_batch(const char * const *filenames, size_t amount, size_t threads);
+// above
+// Loads every file with prepare_tssb() and parse_tssb(), or with parse_essb(SOURCE_FILE) if it's ESSB file, using
+// _threads_ threads (calling thread is one of them). Pass 0 to use one thread per online CPU.
+// Errors are per file: errreasonstr of batch is set only if batch itself can't be loaded.
+
+ssb_batch load_ssb_directory(const char *directory, size_t threads);
+// above
+// Just like load_ssb_batch(), but loads every file from _directory_, except hidden ones. Files are sorted by name.
+
+void release_ssb_batch(ssb_batch *b);
+// above
+// Releases every loaded file and batch itself. After that ssb_batch object is zeroed.
+
+#endif // PROTECTOR_LIBSSB_BATCH_H
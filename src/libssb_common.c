@@ -31,10 +31,13 @@
 #endif
 
 #include <stdlib.h> // size_t
+#include <stddef.h> // offsetof
 #include <stdint.h> // uintblablabla_t
 #include <stdbool.h>
 #include <string.h>
 #include <iso646.h>
+#include <errno.h>
+#include <limits.h>
 
 #define SSB_ALIGN_FUCKING_POINTERS 8 // When you are operating with pointers which storing in manually allocated space
 // and they are using in loop...
@@ -43,6 +46,28 @@
 // Thank god we have -fsanitize=undefined which is MUCH better in clang rather then in gcc.
 // Because when I compiled my code with gcc and -fsantitize=undefined there was no segfaults.
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) // clang defines it too
+#define SSB_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) // clang defines it too
+#define SSB_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define SSB_PREFETCH(address) ((void) (address))
+#endif
+
+#if defined(SSB_UNCHECKED)
+#define SSB_CHECKED 0
+#else
+#define SSB_CHECKED 1
+#endif
+#define SSB_MALFORMED(condition) (SSB_CHECKED and (condition))
+// above
+// Bounds, sum and overflow checks of every size field are fused into parse loops, so they're nearly free and enabled
+// by default. Define SSB_UNCHECKED only if every file you're loading is produced by yourself. Checks of headers are
+// performed in any case.
+
 #if !defined(strizeof)
 #define strizeof(a) (sizeof(a)-1)
 #endif
@@ -52,11 +77,11 @@
 #endif
 
 #if defined(SSB_POSIX_0)
-#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
-#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 #define POSIX_FAILURE_RETVAL -1
 
@@ -72,7 +97,7 @@ int fstat_getsize(int fd, size_t *size) {
 	return rval;
 }
 
-inline ssize_t nposix_pread(int fd, void *buf, size_t count, off_t offset) {
+static inline ssize_t nposix_pread(int fd, void *buf, size_t count, off_t offset) {
 	// above
 	// it's pread() when available
 	// If system haven't required standard, then use non-atomic usage of lseek() and read().
@@ -105,6 +130,265 @@ void swapbytes_priv_ssb(void *pv, size_t n) {
 	}
 }
 
+static inline uint8_t bswap8_priv_ssb(uint8_t v) {
+	// above
+	// Fixed width swaps, one for every width of size field, so that macro generated loops can pick them by width.
+	// Every sane compiler turns these shifts into single bswap (or rev) instruction.
+
+	return v;
+}
+
+static inline uint16_t bswap16_priv_ssb(uint16_t v) {
+	return (uint16_t) (v >> 8 | v << 8);
+}
+
+static inline uint32_t bswap32_priv_ssb(uint32_t v) {
+	return v >> 24 | (v >> 8 & 0xFF00u) | (v << 8 & 0xFF0000u) | v << 24;
+}
+
+static inline uint64_t bswap64_priv_ssb(uint64_t v) {
+	return (uint64_t) bswap32_priv_ssb((uint32_t) v) << 32 | bswap32_priv_ssb((uint32_t) (v >> 32));
+}
+
+void bswap32_bulk_scalar_priv_ssb(void *dst, const void *src, size_t n) {
+	// above
+	// Stores _n_ 4 byte elements from _src_ to _dst_ with swapped bytes. Both may be unaligned, and may be the same
+	// pointer for swapping in place (but areas must not overlap otherwise).
+
+	char *d = dst;
+	const char *s = src;
+	for (size_t i = 0; i < n; i++, d += sizeof(uint32_t), s += sizeof(uint32_t)) {
+		uint32_t v;
+		memcpy(&v, s, sizeof(v));
+		v = bswap32_priv_ssb(v);
+		memcpy(d, &v, sizeof(v));
+	}
+}
+
+#if defined(SSB_X86_SIMD)
+__attribute__((target("ssse3"))) void bswap32_bulk_ssse3_priv_ssb(void *dst, const void *src, size_t n) {
+	// above
+	// Same as bswap32_bulk_scalar_priv_ssb(), but pshufb reverses four elements per instruction.
+
+	const __m128i reverse = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	char *d = dst;
+	const char *s = src;
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4, d += sizeof(__m128i), s += sizeof(__m128i)) {
+		_mm_storeu_si128((__m128i *) d, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) s), reverse));
+	}
+	bswap32_bulk_scalar_priv_ssb(d, s, n - i);
+}
+
+__attribute__((target("avx2"))) void bswap32_bulk_avx2_priv_ssb(void *dst, const void *src, size_t n) {
+	// above
+	// Same as SSSE3 version, but eight elements per instruction. Shuffle works inside of 128 bit lanes, which is
+	// exactly what is required here.
+
+	const __m256i reverse = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	char *d = dst;
+	const char *s = src;
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8, d += sizeof(__m256i), s += sizeof(__m256i)) {
+		_mm256_storeu_si256((__m256i *) d, _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) s), reverse));
+	}
+	bswap32_bulk_scalar_priv_ssb(d, s, n - i);
+}
+#endif // SSB_X86_SIMD
+
+void bswap32_bulk_priv_ssb(void *dst, const void *src, size_t n) {
+	// above
+	// Picks the best bswap32_bulk_*_priv_ssb() variant available on running CPU once, then calls it.
+
+	static void (*kernel)(void *, const void *, size_t) = NULL; // racing threads are writing same value
+	if (kernel == NULL) {
+		kernel = bswap32_bulk_scalar_priv_ssb;
+#if defined(SSB_X86_SIMD)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("ssse3")) kernel = bswap32_bulk_ssse3_priv_ssb;
+		if (__builtin_cpu_supports("avx2")) kernel = bswap32_bulk_avx2_priv_ssb;
+#endif
+	}
+	kernel(dst, src, n);
+}
+
+static inline uint32_t abs_prefix_sum_tail_priv_ssb(const int32_t *src, int32_t *dst, size_t n, uint32_t total) {
+	// above
+	// Scalar exclusive prefix sum of absolute values which is starting from _total_.
+
+	uint32_t seen = 0;
+	for (size_t i = 0; i < n; i++) {
+		dst[i] = (int32_t) total;
+		if (SSB_CHECKED) seen |= total;
+		total += src[i] < 0 ? - (uint32_t) src[i] : (uint32_t) src[i];
+	}
+	return total | (seen & 0x80000000u);
+}
+
+uint32_t abs_prefix_sum_scalar_priv_ssb(const int32_t *src, int32_t *dst, size_t n) {
+	// above
+	// Stores to dst[i] sum of absolute values of src[0] ... src[i - 1]. In other words, it's exclusive prefix sum.
+	// Returns sum of absolute values of all src elements. Arithmetic is wrapping around, just like in SIMD versions.
+	// Every element adds 2^31 at most, so sum can't wrap until some dst[i] has reached 2^31. If it has, bit 31 of
+	// return value is set too, so any result which fits in int32_t is an exact sum (unless SSB_UNCHECKED is defined).
+
+	return abs_prefix_sum_tail_priv_ssb(src, dst, n, 0);
+}
+
+#if defined(SSB_X86_SIMD)
+__attribute__((target("sse2"))) uint32_t abs_prefix_sum_sse2_priv_ssb(const int32_t *src, int32_t *dst, size_t n) {
+	// above
+	// Same as abs_prefix_sum_scalar_priv_ssb(), but four elements per iteration. Absolute values are calculated
+	// as (x ^ sign) - sign, because SSE2 has no pabsd. Then inclusive prefix sum is evaluated inside register with
+	// two shifted additions, original values are subtracted to make it exclusive, and running total is added.
+
+	__m128i carry = _mm_setzero_si128(); // running total in every lane
+	__m128i seen = _mm_setzero_si128(); // every stored value, ored
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i sign = _mm_srai_epi32(x, 31);
+		x = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+		__m128i s = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+		s = _mm_add_epi32(s, _mm_slli_si128(s, 8));
+		__m128i stored = _mm_add_epi32(_mm_sub_epi32(s, x), carry);
+		_mm_storeu_si128((__m128i *) (dst + i), stored);
+		if (SSB_CHECKED) seen = _mm_or_si128(seen, stored);
+		carry = _mm_add_epi32(carry, _mm_shuffle_epi32(s, 0xFF));
+	}
+	uint32_t poison = _mm_movemask_ps(_mm_castsi128_ps(seen)) ? 0x80000000u : 0;
+	return abs_prefix_sum_tail_priv_ssb(src + i, dst + i, n - i, (uint32_t) _mm_cvtsi128_si32(carry)) | poison;
+}
+
+__attribute__((target("avx2"))) uint32_t abs_prefix_sum_avx2_priv_ssb(const int32_t *src, int32_t *dst, size_t n) {
+	// above
+	// Same as SSE2 version, but eight elements per iteration. Byte shifts are working inside of 128 bit lanes,
+	// so the last sum of lower lane is additionally added to every element of upper lane.
+
+	__m256i carry = _mm256_setzero_si256();
+	__m256i seen = _mm256_setzero_si256();
+	const __m256i last = _mm256_set1_epi32(7);
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_abs_epi32(_mm256_loadu_si256((const __m256i *) (src + i)));
+		__m256i s = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+		s = _mm256_add_epi32(s, _mm256_slli_si256(s, 8));
+		__m256i lower = _mm256_shuffle_epi32(s, 0xFF);
+		s = _mm256_add_epi32(s, _mm256_permute2x128_si256(lower, lower, 0x08)); // zero to lower lane, lower to upper
+		__m256i stored = _mm256_add_epi32(_mm256_sub_epi32(s, x), carry);
+		_mm256_storeu_si256((__m256i *) (dst + i), stored);
+		if (SSB_CHECKED) seen = _mm256_or_si256(seen, stored);
+		carry = _mm256_add_epi32(carry, _mm256_permutevar8x32_epi32(s, last));
+	}
+	uint32_t poison = _mm256_movemask_ps(_mm256_castsi256_ps(seen)) ? 0x80000000u : 0;
+	return abs_prefix_sum_tail_priv_ssb(src + i, dst + i, n - i, (uint32_t) _mm256_extract_epi32(carry, 0)) | poison;
+}
+#endif // SSB_X86_SIMD
+
+uint32_t abs_prefix_sum_priv_ssb(const int32_t *src, int32_t *dst, size_t n) {
+	// above
+	// Picks the best abs_prefix_sum_*_priv_ssb() variant available on running CPU once, then calls it.
+
+	static uint32_t (*kernel)(const int32_t *, int32_t *, size_t) = NULL; // racing threads are writing same value
+	if (kernel == NULL) {
+		kernel = abs_prefix_sum_scalar_priv_ssb;
+#if defined(SSB_X86_SIMD)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2")) kernel = abs_prefix_sum_sse2_priv_ssb;
+		if (__builtin_cpu_supports("avx2")) kernel = abs_prefix_sum_avx2_priv_ssb;
+#endif
+	}
+	return kernel(src, dst, n);
+}
+
+const char *find_substring_scalar_priv_ssb(const char *from, const char *end, const char *needle, size_t size) {
+	// above
+	// Returns first occurrence of _size_ bytes of _needle_ (size is not 0) between _from_ and _end_, or NULL.
+	// memchr() is vectorized by every sane libc, so it's used to skip to candidates, which are confirmed by memcmp().
+
+	while ((size_t) (end - from) >= size) {
+		const char *candidate = memchr(from, needle[0], (size_t) (end - from) - size + 1);
+		if (candidate == NULL) return NULL;
+		if (memcmp(candidate + 1, needle + 1, size - 1) == 0) return candidate;
+		from = candidate + 1;
+	}
+	return NULL;
+}
+
+#if defined(SSB_X86_SIMD)
+__attribute__((target("sse2"))) const char *find_substring_sse2_priv_ssb(const char *from, const char *end, const char *needle, size_t size) {
+	// above
+	// Same as scalar version, but candidate has to match both first and last byte of needle, which are compared for
+	// 16 positions at once. memchr() stops on every first byte, so it's slow when that byte is common in text, like
+	// '<' in HTML or '{' in JSON. Only positions which are matching both are confirmed by memcmp().
+
+	if (size < 2) return find_substring_scalar_priv_ssb(from, end, needle, size);
+	const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[size - 1]);
+	for (; (size_t) (end - from) >= size - 1 + sizeof(__m128i); from += sizeof(__m128i)) {
+		__m128i head = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) from), first);
+		__m128i tail = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (from + size - 1)), last);
+		for (unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(head, tail)); mask; mask &= mask - 1) {
+			const char *candidate = from + __builtin_ctz(mask);
+			if (memcmp(candidate + 1, needle + 1, size - 2) == 0) return candidate;
+		}
+	}
+	return find_substring_scalar_priv_ssb(from, end, needle, size);
+}
+
+__attribute__((target("avx2"))) const char *find_substring_avx2_priv_ssb(const char *from, const char *end, const char *needle, size_t size) {
+	// above
+	// Same as SSE2 version, but 32 positions at once.
+
+	if (size < 2) return find_substring_scalar_priv_ssb(from, end, needle, size);
+	const __m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(needle[size - 1]);
+	for (; (size_t) (end - from) >= size - 1 + sizeof(__m256i); from += sizeof(__m256i)) {
+		__m256i head = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) from), first);
+		__m256i tail = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (from + size - 1)), last);
+		for (unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(head, tail)); mask; mask &= mask - 1) {
+			const char *candidate = from + __builtin_ctz(mask);
+			if (memcmp(candidate + 1, needle + 1, size - 2) == 0) return candidate;
+		}
+	}
+	return find_substring_scalar_priv_ssb(from, end, needle, size);
+}
+#endif // SSB_X86_SIMD
+
+const char *find_substring_priv_ssb(const char *from, const char *end, const char *needle, size_t size) {
+	// above
+	// Picks the best find_substring_*_priv_ssb() variant available on running CPU once, then calls it.
+
+	static const char *(*kernel)(const char *, const char *, const char *, size_t) = NULL; // racing threads are writing same value
+	if (kernel == NULL) {
+		kernel = find_substring_scalar_priv_ssb;
+#if defined(SSB_X86_SIMD)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("sse2")) kernel = find_substring_sse2_priv_ssb;
+		if (__builtin_cpu_supports("avx2")) kernel = find_substring_avx2_priv_ssb;
+#endif
+	}
+	return kernel(from, end, needle, size);
+}
+
+uint64_t hash_priv_ssb(const void *data, size_t size) {
+	// above
+	// Non-cryptographic hash for lookup tables. Eight bytes per multiplication, so short keys are cheap.
+	// Result depends on byte order of platform, so never store it in files.
+
+	const unsigned char *p = data;
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ size;
+	for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+		h ^= h >> 32;
+	}
+	uint64_t v = 0;
+	memcpy(&v, p, size);
+	h = (h ^ v) * 0xC4CEB9FE1A85EC53ull;
+	return h ^ (h >> 29);
+}
+
 void *mcalloc(size_t size) {
 	// above
 	// It is like malloc, but everything is initialized to zero.
@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_PACKED_C
+#define PROTECTOR_LIBSSB_PACKED_C
+
+#include <libtssb.c>
+#include <libssb_packed.h>
+
+const char tssb_signature_packed[] = "SSBTRANSLATI0NS_Z"; // block directory, then compressed blocks of rows
+
+#define TSSB_PACKED_HEADER 36 // signature, rows, cols, sizestorage and padding, rows per block, amount of blocks
+#define TSSB_PACKED_ENTRY 16 // offset of compressed block (uint64_t), its size and size of decompressed block (uint32_t)
+#define TSSB_PACKED_SIZESTORAGE 25 // positions of fields in header
+#define TSSB_PACKED_GEOMETRY 28
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET UINT16_MAX
+#define LZ_HASH_BITS 12
+#define LZ_BOUND(size) ((size) + (size) / 255 + 16)
+#define LZ_MAX_RATIO 255 // decompressed block can't be bigger than that many times compressed one
+#define LZ_SHORT 16 // short literals and matches are copied by fixed size, if there is enough room for that
+// above
+// Built-in codec is a byte-oriented LZ77 without entropy coding, so decompression is a simple copy loop. Every
+// sequence is: token (upper 4 bits are amount of literals, lower 4 bits are match length - LZ_MIN_MATCH), more bytes
+// of literals amount if it's 15 (every 255 byte means "add 255 and read one more"), literals themselves, 2 byte
+// little endian offset of match, more bytes of match length if it's 15. Last sequence has literals only.
+
+static size_t lz_length(uint8_t *dst, size_t capacity, size_t op, size_t length) {
+	for (; length >= UINT8_MAX; length -= UINT8_MAX) {
+		if (op >= capacity) return SIZE_MAX;
+		dst[op++] = UINT8_MAX;
+	}
+	if (op >= capacity) return SIZE_MAX;
+	dst[op++] = (uint8_t) length;
+	return op;
+}
+
+static size_t lz_sequence(uint8_t *dst, size_t capacity, size_t op, const uint8_t *literals, size_t amount,
+	size_t offset, size_t length) {
+	// above
+	// Emits one sequence at _op_ and returns position after it, or SIZE_MAX if it doesn't fit. Zero _length_ means
+	// last sequence without match.
+
+	if (op >= capacity) return SIZE_MAX;
+	size_t token = op++;
+	dst[token] = (amount < 15 ? amount : 15) << 4;
+	if (amount >= 15 and (op = lz_length(dst, capacity, op, amount - 15)) == SIZE_MAX) return SIZE_MAX;
+	if (amount > capacity - op) return SIZE_MAX;
+	memcpy(dst + op, literals, amount);
+	op += amount;
+	if (length == 0) return op;
+
+	if (capacity - op < sizeof(uint16_t)) return SIZE_MAX;
+	dst[op++] = offset & UINT8_MAX;
+	dst[op++] = offset >> CHAR_BIT;
+	length -= LZ_MIN_MATCH;
+	dst[token] |= length < 15 ? length : 15;
+	if (length >= 15) return lz_length(dst, capacity, op, length - 15);
+	return op;
+}
+
+static size_t lz_compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) {
+	// above
+	// Greedy compression with single entry hash table of 4 byte sequences. Returns compressed size, or 0 if it
+	// doesn't fit in _capacity_ (LZ_BOUND() always fits).
+
+	uint32_t table[1 << LZ_HASH_BITS] = {0}; // position + 1, so 0 is empty entry
+	size_t ip = 0, anchor = 0, op = 0;
+	while (size >= LZ_MIN_MATCH and ip <= size - LZ_MIN_MATCH) {
+		uint32_t sequence;
+		memcpy(&sequence, src + ip, sizeof(sequence));
+		uint32_t h = (sequence * UINT32_C(2654435761)) >> (32 - LZ_HASH_BITS);
+		size_t candidate = table[h];
+		table[h] = (uint32_t) ip + 1;
+		if (candidate-- == 0 or ip - candidate > LZ_MAX_OFFSET or memcmp(src + candidate, src + ip, LZ_MIN_MATCH) != 0) {
+			ip++;
+			continue;
+		}
+		size_t length = LZ_MIN_MATCH;
+		while (ip + length < size and src[candidate + length] == src[ip + length]) length++;
+		op = lz_sequence(dst, capacity, op, src + anchor, ip - anchor, ip - candidate, length);
+		if (op == SIZE_MAX) return 0;
+		ip += length;
+		anchor = ip;
+	}
+	op = lz_sequence(dst, capacity, op, src + anchor, size - anchor, 0, 0);
+	return op == SIZE_MAX ? 0 : op;
+}
+
+static bool lz_read_length(const uint8_t *src, size_t size, size_t *ip, size_t *length) {
+	uint8_t byte;
+	do {
+		if (*ip >= size or *length > SIZE_MAX - UINT8_MAX) return false;
+		byte = src[(*ip)++];
+		*length += byte;
+	} while (byte == UINT8_MAX);
+	return true;
+}
+
+static bool lz_decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t raw) {
+	// above
+	// Decompresses exactly _raw_ bytes. Every length and offset is checked, so malformed block can't read or write
+	// outside of buffers. Most sequences are short, and fixed size copy of LZ_SHORT bytes is just two moves, so
+	// extra bytes are written if they're overwritten later anyway.
+
+	size_t ip = 0, op = 0;
+	while (ip < size) {
+		unsigned token = src[ip++];
+		size_t amount = token >> 4;
+		if (amount == 15 and lz_read_length(src, size, &ip, &amount) == false) return false;
+		if (amount > size - ip or amount > raw - op) return false;
+		if (amount <= LZ_SHORT and size - ip >= LZ_SHORT and raw - op >= LZ_SHORT) memcpy(dst + op, src + ip, LZ_SHORT);
+		else memcpy(dst + op, src + ip, amount);
+		ip += amount;
+		op += amount;
+		if (ip == size) break; // last sequence
+
+		if (size - ip < sizeof(uint16_t)) return false;
+		size_t offset = src[ip] | (size_t) src[ip + 1] << CHAR_BIT;
+		ip += sizeof(uint16_t);
+		size_t length = token & 15;
+		if (length == 15 and lz_read_length(src, size, &ip, &length) == false) return false;
+		length += LZ_MIN_MATCH;
+		if (offset == 0 or offset > op or length > raw - op) return false;
+		if (length <= LZ_SHORT and offset >= LZ_SHORT and raw - op >= LZ_SHORT) {
+			memcpy(dst + op, dst + op - offset, LZ_SHORT);
+			op += length;
+			continue;
+		}
+		size_t end = op + length;
+		for (size_t start = op - offset; op < end;) { // overlapping match repeats pattern, so every copy doubles it
+			size_t chunk = op - start < end - op ? op - start : end - op;
+			memcpy(dst + op, dst + start, chunk);
+			op += chunk;
+		}
+	}
+	return op == raw;
+}
+
+static size_t skip_tssb_rows(tssb u, size_t pos, size_t *rows) {
+	// above
+	// Walks up to *rows rows, starting at newline sigil at _pos_. Returns position of newline sigil of next row (or
+	// end of object), and *rows is amount of walked rows. Sizes are read as little endian, so object must not be
+	// parsed on big endian platform. SIZE_MAX means that object is malformed.
+
+	const uint64_t sigil = u.sizestorage == sizeof(uint64_t) ? UINT64_MAX : (UINT64_C(1) << u.sizestorage * CHAR_BIT) - 1;
+	size_t walked = 0, col = 0;
+	while (pos < u.size) {
+		if (u.size - pos < u.sizestorage) return SIZE_MAX;
+		uint64_t bsize = get_le(u.source + pos, u.sizestorage);
+		if (bsize == sigil) {
+			if (walked == *rows) break;
+			walked++;
+			col = 0;
+			pos += u.sizestorage;
+			continue;
+		}
+		pos += u.sizestorage;
+		if (walked == 0 or col++ >= u.cols or bsize > u.size - pos) return SIZE_MAX;
+		pos += bsize;
+	}
+	*rows = walked;
+	return pos;
+}
+
+static size_t packed_geometry(tssb *p, size_t *rows_per_block, size_t *rows, size_t *first) {
+	// above
+	// Counts rows which are actually present and returns amount of blocks, or 0 if object can't be packed.
+
+	if (p->errreasonstr != NULL) return 0;
+	if (*rows_per_block == 0) *rows_per_block = TSSB_PACKED_ROWS;
+	*first = first_row_position(*p);
+	*rows = p->rows;
+	if (*first == 0 or skip_tssb_rows(*p, *first, rows) != p->size) {
+		p->errreasonstr = err_parse_fail;
+		return 0;
+	}
+	if (*rows == 0 or *rows_per_block > UINT32_MAX) {
+		p->errreasonstr = err_out_of_table;
+		return 0;
+	}
+	return (*rows - 1) / *rows_per_block + 1;
+}
+
+size_t calculate_tssb_pack(tssb *p, size_t rows_per_block) {
+	size_t rows, first;
+	size_t blocks = packed_geometry(p, &rows_per_block, &rows, &first);
+	if (blocks == 0) return 0;
+	size_t body = p->size - first;
+	if (blocks > (SIZE_MAX - TSSB_PACKED_HEADER - LZ_BOUND(body)) / (TSSB_PACKED_ENTRY + 16)) {
+		p->errreasonstr = err_out_of_table;
+		return 0;
+	}
+	return TSSB_PACKED_HEADER + blocks * TSSB_PACKED_ENTRY + LZ_BOUND(body) + blocks * 16;
+}
+
+size_t pack_tssb(tssb *p, size_t rows_per_block, void *buffer, size_t size) {
+	size_t total = calculate_tssb_pack(p, rows_per_block);
+	if (total == 0) return 0;
+	if (size < total) {
+		p->errreasonstr = err_invalid_size;
+		return 0;
+	}
+
+	size_t rows, first;
+	size_t blocks = packed_geometry(p, &rows_per_block, &rows, &first);
+	char *out = buffer;
+	memset(out, 0, TSSB_PACKED_HEADER);
+	memcpy(out, tssb_signature_packed, strizeof(tssb_signature_packed));
+	put_le(out + strizeof(tssb_signature_packed), rows, sizeof(uint32_t));
+	put_le(out + strizeof(tssb_signature_packed) + sizeof(uint32_t), p->cols, sizeof(uint32_t));
+	out[TSSB_PACKED_SIZESTORAGE] = (char) p->sizestorage;
+	put_le(out + TSSB_PACKED_GEOMETRY, rows_per_block, sizeof(uint32_t));
+	put_le(out + TSSB_PACKED_GEOMETRY + sizeof(uint32_t), blocks, sizeof(uint32_t));
+
+	size_t written = TSSB_PACKED_HEADER + blocks * TSSB_PACKED_ENTRY;
+	size_t pos = first;
+	for (size_t block = 0; block < blocks; block++) {
+		size_t amount = rows_per_block;
+		size_t end = skip_tssb_rows(*p, pos, &amount);
+		size_t raw = end - pos;
+		size_t packed = raw > UINT32_MAX ? 0 : lz_compress((const uint8_t *) p->source + pos, raw, (uint8_t *) out + written, size - written);
+		if (packed == 0 or packed > UINT32_MAX) {
+			p->errreasonstr = err_out_of_table; // decompressed block must fit in 4GB
+			return 0;
+		}
+		char *entry = out + TSSB_PACKED_HEADER + block * TSSB_PACKED_ENTRY;
+		put_le(entry, written, sizeof(uint64_t));
+		put_le(entry + sizeof(uint64_t), packed, sizeof(uint32_t));
+		put_le(entry + sizeof(uint64_t) + sizeof(uint32_t), raw, sizeof(uint32_t));
+		written += packed;
+		pos = end;
+	}
+	return written;
+}
+
+#if defined(SSB_POSIX_0)
+bool write_tssb_packed(tssb *p, size_t rows_per_block, int fd) {
+	size_t total = calculate_tssb_pack(p, rows_per_block);
+	if (total == 0) return false;
+	char *buffer = malloc(total);
+	if (buffer == NULL) {
+		p->errreasonstr = strerror(errno);
+		return false;
+	}
+	size_t written = pack_tssb(p, rows_per_block, buffer, total);
+	bool success = written > 0 and write_all(fd, buffer, written);
+	if (written > 0 and success == false) p->errreasonstr = strerror(errno);
+	free(buffer);
+	return success;
+}
+#endif // SSB_POSIX_0
+
+static bool check_packed_directory(tssb_packed *p) {
+	// above
+	// Every block must be located after directory and inside object, and its decompressed size must be possible
+	// for its compressed size, so malformed directory can't make us allocate huge cache.
+
+	size_t minimal = TSSB_PACKED_HEADER + p->blocks * TSSB_PACKED_ENTRY;
+	for (size_t block = 0; block < p->blocks; block++) {
+		const char *entry = p->directory + block * TSSB_PACKED_ENTRY;
+		uint64_t offset = get_le(entry, sizeof(uint64_t));
+		uint64_t packed = get_le(entry + sizeof(uint64_t), sizeof(uint32_t));
+		uint64_t raw = get_le(entry + sizeof(uint64_t) + sizeof(uint32_t), sizeof(uint32_t));
+		if (offset < minimal or offset > p->u.size or packed > p->u.size - offset or raw == 0 or raw > packed * LZ_MAX_RATIO) {
+			return false;
+		}
+		if (raw > p->largest) p->largest = raw;
+	}
+	return true;
+}
+
+static tssb_packed open_packed(const char *object, size_t size, size_t cache_blocks) {
+	tssb_packed p = {.errreasonstr = NULL};
+	p.u.source = (char *) object;
+	p.u.size = size;
+
+	uint32_t rowncol[2];
+	if (object == NULL or size < TSSB_PACKED_HEADER or memcmp(object, tssb_signature_packed, strizeof(tssb_signature_packed)) != 0) {
+		p.errreasonstr = err_not_a_valid_tssb;
+		return p;
+	}
+	memcpy(rowncol, object + strizeof(tssb_signature_packed), sizeof(rowncol));
+	if (set_ssb_dimensions(rowncol, &p.u) == false) {
+		p.errreasonstr = p.u.errreasonstr;
+		return p;
+	}
+	p.u.sizestorage = (unsigned char) object[TSSB_PACKED_SIZESTORAGE];
+	p.rows_per_block = get_le(object + TSSB_PACKED_GEOMETRY, sizeof(uint32_t));
+	p.blocks = get_le(object + TSSB_PACKED_GEOMETRY + sizeof(uint32_t), sizeof(uint32_t));
+	p.directory = object + TSSB_PACKED_HEADER;
+	if (p.u.sizestorage > sizeof(uint64_t) or signatures[p.u.sizestorage] == &empty_string or p.rows_per_block == 0 or
+		p.blocks != (p.u.rows - 1) / p.rows_per_block + 1 or p.blocks > (size - TSSB_PACKED_HEADER) / TSSB_PACKED_ENTRY or
+		check_packed_directory(&p) == false) {
+		p.errreasonstr = err_not_a_valid_tssb;
+		return p;
+	}
+	if (p.u.cols > max_acceptable_dimension_size or p.rows_per_block > max_acceptable_dimension_size) {
+		p.errreasonstr = err_out_of_table;
+		return p;
+	}
+
+	p.slots_amount = cache_blocks ? cache_blocks : TSSB_PACKED_CACHE;
+	if (p.slots_amount > p.blocks) p.slots_amount = p.blocks;
+	p.slots = malloc(p.slots_amount * sizeof(tssb_packed_slot));
+	if (p.slots == NULL) {
+		p.errreasonstr = strerror(errno);
+		return p;
+	}
+	for (size_t i = 0; i < p.slots_amount; i++) p.slots[i] = (tssb_packed_slot) {.block = SIZE_MAX};
+	return p;
+}
+
+static tssb_packed reject_packed(tssb_packed p) {
+	// above
+	// Releases everything that was obtained for malformed object, but keeps the reason.
+
+	if (p.errreasonstr == NULL) return p;
+	const char *reason = p.errreasonstr;
+	release_tssb_packed(&p);
+	p.errreasonstr = reason;
+	return p;
+}
+
+tssb_packed prepare_tssb_packed_addr(const void *source, size_t size, size_t cache_blocks) {
+	return reject_packed(open_packed(source, size, cache_blocks));
+}
+
+#if defined(SSB_POSIX_0)
+tssb_packed prepare_tssb_packed(const char *filename, size_t cache_blocks) {
+	tssb_packed p = {.errreasonstr = NULL};
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		p.errreasonstr = strerror(errno);
+		return p;
+	}
+	size_t size;
+	if (fstat_getsize(fd, &size) < 0) {
+		p.errreasonstr = strerror(errno);
+		close(fd);
+		return p;
+	}
+	if (size < TSSB_PACKED_HEADER) {
+		p.errreasonstr = err_not_a_valid_tssb;
+		close(fd);
+		return p;
+	}
+	void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0); // compressed blocks are never written
+	close(fd);
+	if (data == MAP_FAILED) {
+		p.errreasonstr = strerror(errno);
+		return p;
+	}
+
+	p = open_packed(data, size, cache_blocks);
+	p.u.flags = TSSB_MAPPED; // so release_tssb() unmaps it
+	return reject_packed(p);
+}
+#endif // SSB_POSIX_0
+
+static bool decompress_block(tssb_packed *p, tssb_packed_slot *s, size_t block) {
+	// above
+	// Decompresses _block_ to slot and parses it with regular parse loop, so cells are checked just like in
+	// parse_tssb(). Slot memory is allocated once, for the largest block.
+
+	tssb u = p->u;
+	u.rows = block == p->blocks - 1 ? p->u.rows - block * p->rows_per_block : p->rows_per_block;
+	size_t table_size = p->rows_per_block * sizeof(void *) + (p->u.cols + 1) * p->rows_per_block * sizeof(void *);
+	if (s->table == NULL) {
+		s->table = malloc(table_size + p->largest);
+		if (s->table == NULL) {
+			p->errreasonstr = strerror(errno);
+			return false;
+		}
+		s->raw = (char *) s->table + table_size;
+	}
+
+	s->block = SIZE_MAX; // slot is empty until block is parsed
+	const char *entry = p->directory + block * TSSB_PACKED_ENTRY;
+	uint64_t offset = get_le(entry, sizeof(uint64_t));
+	u.source = s->raw;
+	u.size = get_le(entry + sizeof(uint64_t) + sizeof(uint32_t), sizeof(uint32_t));
+	size_t packed = get_le(entry + sizeof(uint64_t), sizeof(uint32_t));
+	if (lz_decompress((const uint8_t *) p->u.source + offset, packed, (uint8_t *) s->raw, u.size) == false) {
+		p->errreasonstr = err_parse_fail;
+		return false;
+	}
+
+	memset(s->table, 0, table_size);
+	size_t row = 0;
+	if (parse_rows(u, s->table, 0, &row, u.rows) != u.size or row != u.rows) {
+		p->errreasonstr = err_parse_fail;
+		return false;
+	}
+	s->block = block;
+	p->misses++;
+	return true;
+}
+
+char **tssb_packed_row(tssb_packed *p, size_t row) {
+	// above
+	// Looks for block in cache, otherwise decompresses it to least recently used slot. Cache is small, so linear
+	// search is faster than anything else.
+
+	if (p->slots == NULL or row >= p->u.rows) return NULL;
+	size_t block = row / p->rows_per_block;
+	tssb_packed_slot *victim = p->slots;
+	for (size_t i = 0; i < p->slots_amount; i++) {
+		tssb_packed_slot *s = p->slots + i;
+		if (s->block == block) {
+			s->used = ++p->clock;
+			return s->table[row % p->rows_per_block];
+		}
+		if (s->used < victim->used) victim = s;
+	}
+	if (decompress_block(p, victim, block) == false) return NULL;
+	victim->used = ++p->clock;
+	return victim->table[row % p->rows_per_block];
+}
+
+void release_tssb_packed(tssb_packed *p) {
+	if (p->slots != NULL) for (size_t i = 0; i < p->slots_amount; i++) free(p->slots[i].table);
+	free(p->slots);
+	release_tssb(&p->u);
+	memset(p, 0, sizeof(tssb_packed));
+}
+
+#endif // PROTECTOR_LIBSSB_PACKED_C
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_PACKED_H
+#define PROTECTOR_LIBSSB_PACKED_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "libtssb.h"
+
+#define TSSB_PACKED_ROWS 64 // default amount of rows in one compressed block
+#define TSSB_PACKED_CACHE 8 // default amount of decompressed blocks which are kept in memory
+
+typedef struct {
+	size_t block; // which block is decompressed here, SIZE_MAX if slot is empty
+	uint64_t used; // when slot was used last time, least recently used slot is reused first
+	char *raw; // decompressed rows: regular TSSB data without signature and dimensions
+	char ***table; // pointers to cells of these rows, just like parse_tssb() result
+} tssb_packed_slot;
+
+typedef struct {
+	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
+	tssb u; // rows, cols and sizestorage of table, so getssbsize() works with cells. Don't parse it
+	size_t rows_per_block; // amount of rows in every block except the last one
+	size_t blocks; // amount of compressed blocks
+	size_t misses; // amount of blocks which were decompressed, useful to choose size of cache
+	const char *directory; // Must not be used by user
+	size_t largest; // size of the largest decompressed block. Must not be used by user
+	tssb_packed_slot *slots; // Must not be used by user
+	size_t slots_amount; // Must not be used by user
+	uint64_t clock; // Must not be used by user
+} tssb_packed;
+
+size_t calculate_tssb_pack(tssb *p, size_t rows_per_block);
+// above
+// Returns amount of bytes which is enough for pack_tssb() result, or 0 if something went wrong. Actual result is
+// usually much smaller. Pass 0 as _rows_per_block_ to use TSSB_PACKED_ROWS.
+
+size_t pack_tssb(tssb *p, size_t rows_per_block, void *buffer, size_t size);
+// above
+// Converts prepared (but not parsed) TSSB object to block-compressed variant (SSBTRANSLATI0NS_Z signature): every
+// _rows_per_block_ rows are compressed independently with built-in LZ codec, and block directory is placed in
+// header. Returns amount of written bytes, or 0 if buffer is not enough or object is malformed.
+// More rows per block compress better, but every access to cold row decompresses whole block.
+
+bool write_tssb_packed(tssb *p, size_t rows_per_block, int fd);
+// above
+// Just like pack_tssb(), but result is written to _fd_.
+
+tssb_packed prepare_tssb_packed(const char *filename, size_t cache_blocks);
+// above
+// Maps block-compressed TSSB file read-only and shared, and checks its directory. Nothing is decompressed yet, so
+// opening is cheap no matter how big table is. At most _cache_blocks_ decompressed blocks are kept in memory
+// (pass 0 to use TSSB_PACKED_CACHE).
+// Every block is parsed into regular pointer table, so both cols and rows per block are limited by
+// max_acceptable_dimension_size. Amount of rows is not.
+
+tssb_packed prepare_tssb_packed_addr(const void *source, size_t size, size_t cache_blocks);
+// above
+// Just like prepare_tssb_packed(), but block-compressed object of _size_ bytes is located in memory at _source_,
+// which must stay valid until release_tssb_packed() call. Source memory is never written.
+
+char **tssb_packed_row(tssb_packed *p, size_t row);
+// above
+// Returns array of pointers to cells of choosen row (terminated with NULL, just like tssb_row() does). Only block
+// which holds that row is decompressed, unless it's still in cache. Use getssbsize(cell, p->u, &size) or GETU**SSB
+// macros for sizes of cells.
+// Returned row is valid until cache slot of its block is reused. Least recently used slot is reused first, so row
+// stays valid during at least _cache_blocks_ - 1 following calls, and it's safe to hold a few rows at once.
+// Returns NULL if row is out of table, or if block is malformed (then errreasonstr is set).
+// tssb_packed_row() modifies tssb_packed object, so don't call it from several threads simultaneously.
+
+void release_tssb_packed(tssb_packed *p);
+// above
+// Frees cache, unmaps file, and zeroes tssb_packed object.
+
+#endif // PROTECTOR_LIBSSB_PACKED_H
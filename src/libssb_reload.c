@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_RELOAD_C
+#define PROTECTOR_LIBSSB_RELOAD_C
+
+#include <libtssb.c>
+#include <libessb.c>
+#include <libssb_reload.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+const char err_no_readers[] = "Amount of reader slots must not be zero.";
+
+#define RELOAD_RECLAIM_INTERVAL 10 // how often (ms) watcher tries to free snapshots which are still in use
+
+static void free_snapshot(ssb_snapshot *s) {
+	release_tssb(&s->u);
+	release_essb(&s->e);
+	free(s);
+}
+
+static ssb_snapshot *load_snapshot(ssb_reload *r) {
+	// above
+	// Loads and completely parses file, so readers will never modify snapshot (e.g. with tssb_row()).
+	// On failure reload_error is set.
+
+	ssb_snapshot *s = calloc(1, sizeof(ssb_snapshot));
+	if (s == NULL) {
+		__atomic_store_n(&r->reload_error, strerror(errno), __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	if (r->kind == SSB_RELOAD_TSSB) {
+		s->u = prepare_tssb(r->filename, NULL, 0);
+		if (s->u.errreasonstr == NULL) s->table = parse_tssb(&s->u);
+		if (s->table == NULL) {
+			__atomic_store_n(&r->reload_error, s->u.errreasonstr, __ATOMIC_RELAXED);
+			free_snapshot(s);
+			return NULL;
+		}
+	} else {
+		if (parse_essb(&s->e, SOURCE_FILE, r->filename, NULL) == false or hash_essb_keys(&s->e, NULL) == false) {
+			__atomic_store_n(&r->reload_error, s->e.errreasonstr, __ATOMIC_RELAXED);
+			free_snapshot(s);
+			return NULL;
+		}
+	}
+
+	return s;
+}
+
+static void reclaim_snapshots(ssb_reload *r) {
+	// above
+	// Snapshot which was retired at epoch E may be used only by readers that have entered at epoch E or earlier.
+	// Must be called with writer mutex locked.
+
+	uint64_t oldest = UINT64_MAX;
+	for (size_t i = 0; i < r->readers_amount; i++) {
+		uint64_t observed = __atomic_load_n(&r->readers[i].epoch, __ATOMIC_SEQ_CST);
+		if (observed != 0 and observed < oldest) oldest = observed;
+	}
+
+	ssb_snapshot **link = &r->retired;
+	while (*link != NULL) {
+		ssb_snapshot *s = *link;
+		if (s->retired < oldest) {
+			*link = s->next;
+			free_snapshot(s);
+		} else link = &s->next;
+	}
+}
+
+bool reload_ssb_now(ssb_reload *r) {
+	pthread_mutex_lock(&r->writer);
+	ssb_snapshot *fresh = load_snapshot(r);
+	if (fresh == NULL) {
+		pthread_mutex_unlock(&r->writer);
+		return false;
+	}
+
+	fresh->version = r->current->version + 1;
+	ssb_snapshot *old = __atomic_exchange_n(&r->current, fresh, __ATOMIC_SEQ_CST);
+	old->retired = __atomic_fetch_add(&r->epoch, 1, __ATOMIC_SEQ_CST);
+	old->next = r->retired;
+	r->retired = old;
+	__atomic_store_n(&r->reload_error, NULL, __ATOMIC_RELAXED);
+	reclaim_snapshots(r);
+	pthread_mutex_unlock(&r->writer);
+	return true;
+}
+
+size_t register_ssb_reader(ssb_reload *r) {
+	for (size_t i = 0; i < r->readers_amount; i++) {
+		uint64_t expected = 0;
+		if (__atomic_compare_exchange_n(&r->readers[i].registered, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) return i;
+	}
+	return SSB_NO_READER;
+}
+
+void unregister_ssb_reader(ssb_reload *r, size_t slot) {
+	__atomic_store_n(&r->readers[slot].epoch, 0, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&r->readers[slot].registered, 0, __ATOMIC_RELEASE);
+}
+
+const ssb_snapshot *enter_ssb_reload(ssb_reload *r, size_t slot) {
+	// above
+	// Epoch is announced before snapshot is loaded. If watcher hasn't seen announcement, it has swapped pointer
+	// before, so this reader can't get retired snapshot.
+
+	__atomic_store_n(&r->readers[slot].epoch, __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&r->current, __ATOMIC_SEQ_CST);
+}
+
+void leave_ssb_reload(ssb_reload *r, size_t slot) {
+	__atomic_store_n(&r->readers[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+#if defined(__linux__)
+static bool is_watched_file(ssb_reload *r, const char *buffer, ssize_t got) {
+	// above
+	// Directory is watched instead of file, so replacing file with rename() is noticed too.
+
+	const char *base = strrchr(r->filename, '/');
+	base = base ? base + 1 : r->filename;
+	bool matched = false;
+	for (const char *p = buffer; p < buffer + got; ) {
+		const struct inotify_event *event = (const void *) p;
+		if (event->len and strcmp(event->name, base) == 0) matched = true;
+		p += sizeof(struct inotify_event) + event->len;
+	}
+	return matched;
+}
+
+static void *watcher_thread(void *arg) {
+	ssb_reload *r = arg;
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	for (;;) {
+		pthread_mutex_lock(&r->writer);
+		int timeout = r->retired ? RELOAD_RECLAIM_INTERVAL : -1;
+		pthread_mutex_unlock(&r->writer);
+
+		struct pollfd fds[2] = {{.fd = r->notify_fd, .events = POLLIN}, {.fd = r->wakeup[0], .events = POLLIN}};
+		if (poll(fds, 2, timeout) < 0 and errno != EINTR) break;
+		if (fds[1].revents) break;
+		if (fds[0].revents & POLLIN) {
+			ssize_t got = read(r->notify_fd, buffer, sizeof(buffer));
+			if (got > 0 and is_watched_file(r, buffer, got)) reload_ssb_now(r);
+		}
+
+		pthread_mutex_lock(&r->writer);
+		reclaim_snapshots(r);
+		pthread_mutex_unlock(&r->writer);
+	}
+
+	return NULL;
+}
+#endif // __linux__
+
+bool start_ssb_reload(ssb_reload *r, const char *filename, ssb_reload_kind kind, size_t readers) {
+	if (r == NULL) return false;
+	if (filename == NULL) {
+		r->errreasonstr = err_invalid_arg;
+		return false;
+	}
+	if (readers == 0) {
+		r->errreasonstr = err_no_readers;
+		return false;
+	}
+#if defined(__linux__)
+	size_t length = strlen(filename);
+	r->filename = malloc(length * 2 + 2); // filename and its directory
+	r->readers = calloc(readers, sizeof(ssb_reader_slot));
+	if (r->filename == NULL or r->readers == NULL) {
+		r->errreasonstr = strerror(errno);
+		goto refree;
+	}
+	memcpy(r->filename, filename, length + 1);
+	char *directory = r->filename + length + 1;
+	memcpy(directory, filename, length + 1);
+	char *slash = strrchr(directory, '/');
+	if (slash == NULL) strcpy(directory, "."); else if (slash == directory) slash[1] = '\0'; else *slash = '\0';
+
+	r->kind = kind;
+	r->readers_amount = readers;
+	r->epoch = 1;
+	r->current = load_snapshot(r);
+	if (r->current == NULL) {
+		r->errreasonstr = __atomic_load_n(&r->reload_error, __ATOMIC_RELAXED);
+		goto refree;
+	}
+	r->current->version = 1;
+	__atomic_store_n(&r->reload_error, NULL, __ATOMIC_RELAXED);
+
+	r->notify_fd = inotify_init1(IN_CLOEXEC);
+	if (r->notify_fd < 0) {
+		r->errreasonstr = strerror(errno);
+		goto resnapshot;
+	}
+	if (inotify_add_watch(r->notify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 or pipe(r->wakeup) < 0) {
+		r->errreasonstr = strerror(errno);
+		goto renotify;
+	}
+	pthread_mutex_init(&r->writer, NULL);
+	int failed = pthread_create(&r->watcher, NULL, watcher_thread, r);
+	if (failed) {
+		r->errreasonstr = strerror(failed);
+		pthread_mutex_destroy(&r->writer);
+		close(r->wakeup[0]);
+		close(r->wakeup[1]);
+		goto renotify;
+	}
+
+	return true;
+	renotify: close(r->notify_fd);
+	resnapshot: free_snapshot(r->current);
+	refree:
+	free(r->filename);
+	free(r->readers);
+	r->filename = NULL;
+	r->readers = NULL;
+	r->current = NULL;
+	return false;
+#endif // __linux__
+	r->errreasonstr = err_not_supported;
+	return false;
+}
+
+void stop_ssb_reload(ssb_reload *r) {
+	if (r->current == NULL) return;
+#if defined(__linux__)
+	while (write(r->wakeup[1], "", 1) < 0 and errno == EINTR);
+	pthread_join(r->watcher, NULL);
+	close(r->wakeup[0]);
+	close(r->wakeup[1]);
+	close(r->notify_fd);
+	pthread_mutex_destroy(&r->writer);
+#endif // __linux__
+
+	while (r->retired != NULL) {
+		ssb_snapshot *next = r->retired->next;
+		free_snapshot(r->retired);
+		r->retired = next;
+	}
+	free_snapshot(r->current);
+	free(r->filename);
+	free(r->readers);
+	memset(r, 0, sizeof(ssb_reload));
+}
+
+#endif // PROTECTOR_LIBSSB_RELOAD_C
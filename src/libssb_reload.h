@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_RELOAD_H
+#define PROTECTOR_LIBSSB_RELOAD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "libtssb.h"
+#include "libessb.h"
+
+typedef enum {SSB_RELOAD_TSSB, SSB_RELOAD_ESSB} ssb_reload_kind;
+
+typedef struct ssb_snapshot {
+	tssb u; // TSSB object, if handle was started with SSB_RELOAD_TSSB
+	char ***table; // and its fully parsed table
+	essb e; // ESSB object with keys index and hash table, if handle was started with SSB_RELOAD_ESSB
+	uint64_t version; // 1 for initial load, incremented by every successful reload
+	uint64_t retired; // epoch when snapshot was replaced. Must not be used by user
+	struct ssb_snapshot *next; // Must not be used by user
+} ssb_snapshot;
+// above
+// Parsed version of file. Everything inside is read only for readers.
+
+typedef struct {
+	uint64_t epoch; // epoch which was observed by reader during enter_ssb_reload(), 0 if reader is quiescent
+	uint64_t registered;
+	char padding[64 - 2 * sizeof(uint64_t)]; // every reader has its own cache line
+} ssb_reader_slot;
+
+typedef struct {
+	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
+	const char *reload_error; // reason of last failed reload, or NULL. Written by watcher thread, so read it with __atomic_load_n()
+	ssb_reload_kind kind;
+	char *filename;
+	ssb_snapshot *current; // published snapshot. Must not be used by user, use enter_ssb_reload()
+	uint64_t epoch; // Must not be used by user
+	ssb_reader_slot *readers; // Must not be used by user
+	size_t readers_amount;
+	ssb_snapshot *retired; // replaced snapshots which may be still used by readers. Must not be used by user
+	int notify_fd; // Must not be used by user
+	int wakeup[2]; // Must not be used by user
+	pthread_t watcher; // Must not be used by user
+	pthread_mutex_t writer; // serializes reloads and reclamation, readers never touch it. Must not be used by user
+} ssb_reload;
+
+bool start_ssb_reload(ssb_reload *r, const char *filename, ssb_reload_kind kind, size_t readers);
+// above
+// Loads file and starts background thread which watches it with inotify. Every time file is rewritten (or replaced
+// with rename()), it's loaded to fresh memory, new snapshot is published with atomic pointer swap and old ones are
+// freed once every reader has left them. _r_ must be zeroed and must stay at same address until stop_ssb_reload().
+// _readers_ is maximum amount of simultaneously registered reader threads. Available on Linux only.
+
+#define SSB_NO_READER SIZE_MAX
+
+size_t register_ssb_reader(ssb_reload *r);
+// above
+// Reserves slot for reader thread. Returns slot number, or SSB_NO_READER if every slot is taken. Lock-free.
+
+void unregister_ssb_reader(ssb_reload *r, size_t slot);
+
+const ssb_snapshot *enter_ssb_reload(ssb_reload *r, size_t slot);
+// above
+// Returns current snapshot. It stays valid until leave_ssb_reload() with same slot, even if newer one is published.
+// Never blocks. Don't nest it: call leave_ssb_reload() before next enter_ssb_reload() with same slot.
+
+void leave_ssb_reload(ssb_reload *r, size_t slot);
+
+bool reload_ssb_now(ssb_reload *r);
+// above
+// Reloads file right now from calling thread, without waiting for inotify.
+
+void stop_ssb_reload(ssb_reload *r);
+// above
+// Stops watcher thread and frees every snapshot. There must be no readers inside enter/leave anymore.
+// After that ssb_reload object is zeroed and can be used again.
+
+#endif // PROTECTOR_LIBSSB_RELOAD_H
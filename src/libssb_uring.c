@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_URING_C
+#define PROTECTOR_LIBSSB_URING_C
+
+#include <libssb_batch.c>
+#include <libssb_uring.h>
+
+#if defined(__linux__) && defined(_GNU_SOURCE)
+#define SSB_URING
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+#endif
+
+enum {STAGE_OPEN, STAGE_STATX, STAGE_READ, STAGE_CLOSE};
+
+static void signal_completion(ssb_uring *r) {
+	write(r->notify_fd, &(uint64_t){1}, sizeof(uint64_t)); // eventfd requires 8 bytes, pipe doesn't care
+}
+
+static void drain_completions(ssb_uring *r) {
+	uint64_t counter;
+	while (read(r->event_fd, &counter, sizeof(counter)) > 0); // it's nonblocking
+}
+
+static void finish_request(ssb_uring *r, ssb_load_request *q) {
+	q->next = NULL;
+	if (r->done_tail) r->done_tail->next = q; else r->done = q;
+	r->done_tail = q;
+}
+
+#if defined(SSB_URING)
+static void parse_buffer(ssb_load_request *q) {
+	// above
+	// Whole file is in memory, so it's parsed in place. ESSB needs room for seek table after it.
+
+	ssb_loaded *f = &q->result;
+	f->u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, q->buffer, q->size, NULL, 0);
+	if (f->u.errreasonstr == NULL) {
+		f->table = parse_tssb(&f->u);
+		f->errreasonstr = f->u.errreasonstr;
+		return;
+	}
+	if (f->u.errreasonstr != err_not_a_valid_tssb) {
+		f->errreasonstr = f->u.errreasonstr;
+		return;
+	}
+
+	release_tssb(&f->u);
+	f->u.errreasonstr = NULL;
+	f->is_essb = true;
+	if (q->size < sizeof(struct essb_format) or check_essb_signature(&f->e, (void *) q->buffer, q->size) == false or
+		q->size < sizeof(struct essb_format) + ESSB_CALCULATE_FILE(f->e)) {
+		f->errreasonstr = err_not_a_valid_essb;
+		memset(&f->e, 0, sizeof(essb));
+		return;
+	}
+	char *grown = realloc(q->buffer, sizeof(struct essb_format) + ESSB_CALCULATE(f->e));
+	memset(&f->e, 0, sizeof(essb));
+	if (grown == NULL) {
+		f->errreasonstr = strerror(errno);
+		return;
+	}
+	q->buffer = grown;
+	if (parse_essb(&f->e, SOURCE_ADDR_INPLACE, q->buffer, q->buffer) == false) f->errreasonstr = f->e.errreasonstr;
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static struct io_uring_sqe *get_sqe(ssb_uring *r, ssb_load_request *q, uint8_t opcode, int fd) {
+	// above
+	// Every request has one operation in flight at most, and there are no more requests in flight than ring
+	// has entries, so submission queue always has room.
+
+	unsigned tail = *r->sq_tail;
+	unsigned index = tail & *r->sq_mask;
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *) r->sqes + index;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = (uintptr_t) q;
+	r->sq_array[index] = index;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	r->to_submit++;
+	return sqe;
+}
+
+static void submit_stage(ssb_uring *r, ssb_load_request *q) {
+	struct io_uring_sqe *sqe;
+	switch (q->stage) {
+	case STAGE_OPEN:
+		sqe = get_sqe(r, q, IORING_OP_OPENAT, AT_FDCWD);
+		sqe->addr = (uintptr_t) q->result.filename;
+		sqe->open_flags = O_RDONLY | O_CLOEXEC;
+		break;
+	case STAGE_STATX:
+		sqe = get_sqe(r, q, IORING_OP_STATX, q->fd);
+		sqe->addr = (uintptr_t) "";
+		sqe->len = STATX_SIZE;
+		sqe->off = (uintptr_t) q->statxbuf;
+		sqe->statx_flags = AT_EMPTY_PATH;
+		break;
+	case STAGE_READ:
+		sqe = get_sqe(r, q, IORING_OP_READ, q->fd);
+		sqe->addr = (uintptr_t) (q->buffer + q->got);
+		sqe->len = q->size - q->got > (1u << 30) ? 1u << 30 : (unsigned) (q->size - q->got);
+		sqe->off = q->got;
+		break;
+	case STAGE_CLOSE:
+		get_sqe(r, q, IORING_OP_CLOSE, q->fd);
+		break;
+	}
+}
+
+static void fail_stage(ssb_load_request *q, const char *reason) {
+	// above
+	// Request is failed, but file has to be closed anyway (if it was opened).
+
+	q->result.errreasonstr = reason;
+	q->stage = STAGE_CLOSE;
+}
+
+static bool advance_request(ssb_uring *r, ssb_load_request *q, int res) {
+	// above
+	// Handles completion of current stage. Returns true if request is completed.
+
+	switch (q->stage) {
+	case STAGE_OPEN:
+		if (res < 0) {
+			q->result.errreasonstr = strerror(-res);
+			return true;
+		}
+		q->fd = res;
+		q->stage = STAGE_STATX;
+		break;
+	case STAGE_STATX:
+		if (res < 0) {
+			fail_stage(q, strerror(-res));
+			break;
+		}
+		q->size = ((struct statx *) q->statxbuf)->stx_size;
+		q->buffer = malloc(q->size ? q->size : 1);
+		if (q->buffer == NULL) fail_stage(q, strerror(errno));
+		else q->stage = q->size ? STAGE_READ : STAGE_CLOSE;
+		break;
+	case STAGE_READ:
+		if (res <= 0) {
+			fail_stage(q, res < 0 ? strerror(-res) : err_file_is_changed);
+			break;
+		}
+		q->got += (size_t) res;
+		if (q->got == q->size) q->stage = STAGE_CLOSE;
+		break;
+	case STAGE_CLOSE:
+		if (q->result.errreasonstr == NULL) parse_buffer(q);
+		return true;
+	}
+	submit_stage(r, q);
+	return false;
+}
+
+static void reap_completions(ssb_uring *r) {
+	unsigned head = *r->cq_head;
+	unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		const struct io_uring_cqe *cqe = (const struct io_uring_cqe *) r->cqes + (head & *r->cq_mask);
+		ssb_load_request *q = (void *) (uintptr_t) cqe->user_data;
+		if (advance_request(r, q, cqe->res)) {
+			r->inflight--;
+			finish_request(r, q);
+		}
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+	while (r->backlog != NULL and r->inflight < r->entries) {
+		ssb_load_request *q = r->backlog;
+		r->backlog = q->next;
+		if (r->backlog == NULL) r->backlog_tail = NULL;
+		r->inflight++;
+		submit_stage(r, q);
+	}
+}
+
+static void flush_submissions(ssb_uring *r) {
+	while (r->to_submit > 0) {
+		int submitted = uring_enter(r->ring_fd, r->to_submit, 0, 0);
+		if (submitted < 0) {
+			if (errno == EINTR or errno == EAGAIN or errno == EBUSY) continue;
+			break;
+		}
+		r->to_submit -= (unsigned) submitted;
+	}
+}
+
+static bool supports_ops(int ring_fd) {
+	// above
+	// io_uring may exist, but be too old for operations of STAGE_* chain. Kernels without probing don't have them
+	// either. Probe has one byte of opcode, so room for 256 entries is always enough.
+
+	enum {probe_ops = UCHAR_MAX + 1};
+	struct io_uring_probe *probe = calloc(1, sizeof(struct io_uring_probe) + probe_ops * sizeof(struct io_uring_probe_op));
+	if (probe == NULL) return false;
+	bool retval = false;
+	if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, probe_ops) >= 0) {
+		const uint8_t required[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE};
+		retval = true;
+		for (size_t i = 0; i < sizeof(required); i++) {
+			if (required[i] >= probe->ops_len or (probe->ops[required[i]].flags & IO_URING_OP_SUPPORTED) == 0) retval = false;
+		}
+	}
+	free(probe);
+	return retval;
+}
+
+static bool setup_ring(ssb_uring *r, unsigned entries) {
+	struct io_uring_params p = {0};
+	r->ring_fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+	if (r->ring_fd < 0) return false;
+	if (supports_ops(r->ring_fd) == false) goto reclose;
+
+	r->entries = p.sq_entries;
+	r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_ring_size > r->sq_ring_size) r->sq_ring_size = r->cq_ring_size;
+		r->cq_ring_size = 0;
+	}
+	r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->ring_fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) goto reclose;
+	r->cq_ring = r->sq_ring;
+	if (r->cq_ring_size) {
+		r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->ring_fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) goto reunmap_sq;
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->ring_fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) goto reunmap_cq;
+	if (syscall(__NR_io_uring_register, r->ring_fd, IORING_REGISTER_EVENTFD, &r->event_fd, 1) < 0) goto reunmap_sqes;
+
+	char *sq = r->sq_ring, *cq = r->cq_ring;
+	r->sq_head = (void *) (sq + p.sq_off.head);
+	r->sq_tail = (void *) (sq + p.sq_off.tail);
+	r->sq_mask = (void *) (sq + p.sq_off.ring_mask);
+	r->sq_array = (void *) (sq + p.sq_off.array);
+	r->cq_head = (void *) (cq + p.cq_off.head);
+	r->cq_tail = (void *) (cq + p.cq_off.tail);
+	r->cq_mask = (void *) (cq + p.cq_off.ring_mask);
+	r->cqes = cq + p.cq_off.cqes;
+	return true;
+
+	reunmap_sqes: munmap(r->sqes, r->sqes_size);
+	reunmap_cq: if (r->cq_ring_size) munmap(r->cq_ring, r->cq_ring_size);
+	reunmap_sq: munmap(r->sq_ring, r->sq_ring_size);
+	reclose: close(r->ring_fd);
+	r->ring_fd = -1;
+	return false;
+}
+#endif // SSB_URING
+
+bool start_ssb_uring(ssb_uring *r, unsigned entries) {
+	if (r == NULL) return false;
+	r->ring_fd = -1;
+#if defined(SSB_URING)
+	r->event_fd = r->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (r->event_fd < 0) {
+		r->errreasonstr = strerror(errno);
+		return false;
+	}
+	if (entries > 0) setup_ring(r, entries); // if it fails, synchronous loading is used
+#else
+	int fds[2];
+	if (pipe(fds) < 0) {
+		r->errreasonstr = strerror(errno);
+		return false;
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	r->event_fd = fds[0];
+	r->notify_fd = fds[1];
+#endif // SSB_URING
+	return true;
+}
+
+bool submit_ssb_load(ssb_uring *r, ssb_load_request *q, const char *filename) {
+	if (q == NULL or filename == NULL) {
+		r->errreasonstr = err_invalid_arg;
+		return false;
+	}
+	memset(&q->result, 0, sizeof(ssb_loaded));
+	q->result.filename = (char *) filename;
+	q->fd = -1;
+	q->stage = STAGE_OPEN;
+	q->buffer = NULL;
+	q->size = 0;
+	q->got = 0;
+	q->next = NULL;
+
+	if (r->ring_fd < 0) {
+		load_file(&q->result);
+		finish_request(r, q);
+		signal_completion(r);
+		return true;
+	}
+
+#if defined(SSB_URING)
+	if (r->inflight < r->entries) {
+		r->inflight++;
+		submit_stage(r, q);
+		flush_submissions(r);
+	} else {
+		if (r->backlog_tail) r->backlog_tail->next = q; else r->backlog = q;
+		r->backlog_tail = q;
+	}
+#endif // SSB_URING
+	return true;
+}
+
+size_t complete_ssb_loads(ssb_uring *r, ssb_load_request **done, size_t max) {
+	drain_completions(r);
+#if defined(SSB_URING)
+	if (r->ring_fd >= 0) {
+		reap_completions(r);
+		flush_submissions(r);
+	}
+#endif // SSB_URING
+
+	size_t amount = 0;
+	while (amount < max and r->done != NULL) {
+		done[amount++] = r->done;
+		r->done = r->done->next;
+	}
+	if (r->done == NULL) r->done_tail = NULL;
+	else signal_completion(r); // some are left, so stay readable
+	return amount;
+}
+
+void release_ssb_load(ssb_load_request *q) {
+	release_tssb(&q->result.u);
+	release_essb(&q->result.e);
+	free(q->buffer);
+	q->buffer = NULL;
+	memset(&q->result, 0, sizeof(ssb_loaded));
+}
+
+void stop_ssb_uring(ssb_uring *r) {
+#if defined(SSB_URING)
+	if (r->ring_fd >= 0) {
+		while (r->inflight > 0 or r->backlog != NULL) {
+			flush_submissions(r);
+			if (uring_enter(r->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 and errno != EINTR) break;
+			reap_completions(r);
+		}
+		munmap(r->sqes, r->sqes_size);
+		if (r->cq_ring_size) munmap(r->cq_ring, r->cq_ring_size);
+		munmap(r->sq_ring, r->sq_ring_size);
+		close(r->ring_fd);
+	}
+#endif // SSB_URING
+	close(r->event_fd);
+	if (r->notify_fd != r->event_fd) close(r->notify_fd);
+	while (r->done != NULL) {
+		ssb_load_request *q = r->done;
+		r->done = q->next;
+		release_ssb_load(q);
+	}
+	memset(r, 0, sizeof(ssb_uring));
+}
+
+#endif // PROTECTOR_LIBSSB_URING_C
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTECTOR_LIBSSB_URING_H
+#define PROTECTOR_LIBSSB_URING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "libssb_batch.h"
+
+typedef struct ssb_load_request {
+	ssb_loaded result; // filled when request is returned by complete_ssb_loads(). Filename is not owned by it
+	void *userdata; // whatever you want, library doesn't touch it
+	int fd; // Must not be used by user
+	unsigned stage; // Must not be used by user
+	char *buffer; // whole file. Must not be used by user
+	size_t size; // Must not be used by user
+	size_t got; // Must not be used by user
+	uint64_t statxbuf[32]; // struct statx. Must not be used by user
+	struct ssb_load_request *next; // Must not be used by user
+} ssb_load_request;
+
+typedef struct {
+	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
+	int event_fd; // becomes readable when some requests are completed, add it to your poll()/epoll
+	int notify_fd; // eventfd (same as event_fd), or write end of pipe if eventfd is unavailable. Must not be used by user
+	int ring_fd; // -1 if io_uring is unavailable, so requests are loaded synchronously during submit_ssb_load()
+	unsigned entries; // Must not be used by user
+	unsigned inflight; // Must not be used by user
+	unsigned to_submit; // Must not be used by user
+	void *sq_ring, *cq_ring, *sqes; // Must not be used by user
+	size_t sq_ring_size, cq_ring_size, sqes_size; // Must not be used by user
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask; // Must not be used by user
+	void *cqes; // Must not be used by user
+	ssb_load_request *backlog, *backlog_tail; // waiting for room in ring. Must not be used by user
+	ssb_load_request *done, *done_tail; // completed, but not returned yet. Must not be used by user
+} ssb_uring;
+
+bool start_ssb_uring(ssb_uring *r, unsigned entries);
+// above
+// Prepares io_uring with _entries_ submission entries for asynchronous loading of TSSB and ESSB files. Every file
+// is opened, measured, read and closed by kernel without blocking calling thread, then it's parsed in memory.
+// If io_uring is unavailable (not Linux, kernel without openat, statx, read or close operations, seccomp, or library
+// is compiled without _GNU_SOURCE), or _entries_ is 0, files are loaded synchronously instead. API is same in both
+// cases. _r_ must be zeroed.
+
+bool submit_ssb_load(ssb_uring *r, ssb_load_request *q, const char *filename);
+// above
+// Starts loading of _filename_. _q_ and _filename_ must stay valid until request is returned by complete_ssb_loads().
+// Never blocks if io_uring is available.
+
+size_t complete_ssb_loads(ssb_uring *r, ssb_load_request **done, size_t max);
+// above
+// Makes progress of every request and puts up to _max_ completed ones to _done_ array. Returns amount of them.
+// Never blocks: call it when event_fd is readable. Check result.errreasonstr of every request.
+
+void release_ssb_load(ssb_load_request *q);
+// above
+// Releases everything loaded for request. After that it can be submitted again.
+
+void stop_ssb_uring(ssb_uring *r);
+// above
+// Waits for requests which are still in progress and releases io_uring. Requests which were not returned by
+// complete_ssb_loads() are released with release_ssb_load(), returned ones are yours to release.
+// After that ssb_uring object is zeroed.
+
+#endif // PROTECTOR_LIBSSB_URING_H
@@ -35,11 +35,25 @@ const char err_file_is_changed[] = "File is changed during program execution";
 const char err_not_a_valid_tssb[] = "This is not a valid tssb file.";
 const char err_out_of_table[] = "Proposed table size is out of acceptable size.";
 const char err_parse_fail[] = "An error occured during parsing.";
+const char err_unsupported_source[] = "This source type is not supported for tssb.";
+const char err_empty_builder[] = "There is nothing to build.";
+const char err_invalid_size[] = "Size of passed memory area doesn't match required one.";
+
+#define TSSB_OWN_SOURCE 0x1 // source was allocated by library
+#define TSSB_OWN_TABLE  0x2 // tablemem was allocated by library
+#define TSSB_MAPPED     0x4 // source is a file mapping
+#define TSSB_APART      0x8 // pointer table is not placed right after source
 
 const char tssb_signature_08bit[] = "SSBTRANSLATI0NS_0";
 const char tssb_signature_16bit[] = "SSBTRANSLATI0NS_1";
 const char tssb_signature_32bit[] = "SSBTRANSLATI0NS_2";
 const char tssb_signature_64bit[] = "SSBTRANSLATI0NS_3";
+const char tssb_signature_indexed[] = "SSBTRANSLATI0NS_I"; // offset table, then regular tssb object
+const char tssb_signature_pooled[] = "SSBTRANSLATI0NS_P"; // offset table, then pool of distinct cells
+
+#define TSSB_INDEXED_HEADER 28 // signature, rows, cols and padding, so offset table is aligned to 4 bytes
+#define TSSB_POOLED_SIZESTORAGE 25 // pooled variant keeps width of size fields in the first byte of padding
+#define TSSB_SHARED_OWN_INDEX 0x1 // index was allocated by library
 const char empty_string = '\0';
 const char * const signatures[] = { // signatures must be regular null-terminated strings because we're going to use strlen() on it
 	&empty_string, // 0
@@ -54,28 +68,67 @@ const char * const signatures[] = { // signatures must be regular null-terminate
 	NULL
 };
 
-static inline unsigned check_signature(int fd, tssb *u) {
+static inline uint64_t get_le(const char *src, size_t width) {
+	// above
+	// Retrieves _width_ bytes little endian value, counterpart of put_le().
+
+	uint64_t value = 0;
+	for (size_t i = width; i > 0; i--) value = value << CHAR_BIT | (unsigned char) src[i - 1];
+	return value;
+}
+
+static inline unsigned match_signature(const char *header, size_t size, tssb *u) {
 	// above
-	// Check TSSB signature.
+	// Check TSSB signature in memory area of _size_ bytes.
 	// If signature is not correct - 0 will be returned.
 	// Otherwise, return value is correspons amount of bytes that
 	// will be used for storing sizes (1, 2, 4 or 8).
 
-	char temp[sizeof(tssb_signature_08bit) + sizeof(uint32_t)];
 	unsigned current_signature = 0;
-	if (nposix_pread(fd, temp, sizeof(temp), 0) < 0) goto posix_error;
 	while(signatures[current_signature] != NULL) {
 		if (signatures[current_signature] == &empty_string) {current_signature++; continue;}
-		if (memcmp(signatures[current_signature], temp, strlen(signatures[current_signature])) == 0) return current_signature;
+		size_t length = strlen(signatures[current_signature]);
+		if (size >= length and memcmp(signatures[current_signature], header, length) == 0) return current_signature;
 		current_signature++;
 	}
 	u->errreasonstr = err_not_a_valid_tssb;
 	return 0;
-	posix_error:
-	u->errreasonstr = strerror(errno);
-	return 0;
 }
 
+#if defined(SSB_POSIX_0)
+static inline unsigned check_signature(int fd, tssb *u) {
+	// above
+	// Check TSSB signature of file. Return value is same as match_signature() has.
+
+	char temp[sizeof(tssb_signature_08bit) + sizeof(uint32_t)];
+	ssize_t got = nposix_pread(fd, temp, sizeof(temp), 0);
+	if (got < 0) {
+		u->errreasonstr = strerror(errno);
+		return 0;
+	}
+	return match_signature(temp, got, u);
+}
+
+#endif // SSB_POSIX_0
+
+static inline bool set_ssb_dimensions(uint32_t rowncol[2], tssb *u) {
+	// above
+	// Check and save amount of rows and cols, which were read from TSSB header
+
+	if (IS_BIG_ENDIAN) {
+		rowncol[0] = bswap32_priv_ssb(rowncol[0]);
+		rowncol[1] = bswap32_priv_ssb(rowncol[1]);
+	}
+	if (rowncol[0] == 0 or rowncol[1] == 0) {
+		u->errreasonstr = err_out_of_table;
+		return false;
+	}
+	u->rows = rowncol[0];
+	u->cols = rowncol[1];
+	return true;
+}
+
+#if defined(SSB_POSIX_0)
 static inline bool get_ssb_dimensions(int fd, tssb *u) {
 	// above
 	// Retrieve amount of cols and rows from TSSB file
@@ -90,16 +143,18 @@ static inline bool get_ssb_dimensions(int fd, tssb *u) {
 		u->errreasonstr = err_not_a_valid_tssb;
 		return false;
 	}
-	if (IS_BIG_ENDIAN) {
-		swapbytes_priv_ssb(&rowncol[0], sizeof(uint32_t));
-		swapbytes_priv_ssb(&rowncol[1], sizeof(uint32_t));
-	}
-	if (rowncol[0] > max_acceptable_dimension_size or rowncol[0] == 0 or rowncol[1] > max_acceptable_dimension_size or rowncol[1] == 0) {
+	return set_ssb_dimensions(rowncol, u);
+}
+#endif // SSB_POSIX_0
+
+static inline bool check_ssb_dimensions(tssb *u) {
+	// above
+	// Check if twodimensional array of pointers for that table is not too huge. Compact index doesn't care.
+
+	if (u->rows > max_acceptable_dimension_size or u->cols > max_acceptable_dimension_size) {
 		u->errreasonstr = err_out_of_table;
 		return false;
 	}
-	u->rows = rowncol[0];
-	u->cols = rowncol[1];
 	return true;
 }
 
@@ -115,6 +170,7 @@ static inline bool get_ssb_dimensions(int fd, tssb *u) {
 // above
 // Like macro above, but instead of setting POSIX errno string we're using user's string.
 
+#if defined(SSB_POSIX_0)
 tssb prepare_tssb(const char *filename, void *stackmem, size_t msize) {
 	// above
 	// Prepares required space for working with TSSB file, performs every (probably) possible check/recheck for
@@ -127,7 +183,7 @@ tssb prepare_tssb(const char *filename, void *stackmem, size_t msize) {
 	if (fstat_getsize(fd, &u.size) < 0) POSIXERR_AND_JUMP(reclose);
 	u.sizestorage = check_signature(fd, &u);
 	if (u.sizestorage == 0) goto reclose;
-	if (get_ssb_dimensions(fd, &u) == false) goto reclose;
+	if (get_ssb_dimensions(fd, &u) == false or check_ssb_dimensions(&u) == false) goto reclose;
 	size_t expected_amount_of_space = SSB_ALIGN_FUCKING_POINTERS + u.size + u.rows * sizeof(void *) + (u.cols + 1) * u.rows * sizeof(void *);
 	char *data;
 	if (stackmem == NULL) {
@@ -143,6 +199,7 @@ tssb prepare_tssb(const char *filename, void *stackmem, size_t msize) {
 	if (u.size != (size_t) got or read(fd, &u.source, sizeof(void *)) > 0) SERR_AND_JUMP(err_file_is_changed, refreeclose);
 	close(fd);
 	u.source = data;
+	if (stackmem == NULL) u.flags = TSSB_OWN_SOURCE;
 	return u;
 
 	refreeclose: if (stackmem == NULL) free(data);
@@ -150,6 +207,50 @@ tssb prepare_tssb(const char *filename, void *stackmem, size_t msize) {
 	ret: return u;
 }
 
+tssb prepare_tssb_mmap(const char *filename, void *stackmem, size_t msize) {
+	// above
+	// Maps TSSB file instead of reading it. The pointer table is placed in stackmem, or allocated by parse_tssb()
+
+	tssb u = {.errreasonstr = NULL};
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) POSIXERR_AND_JUMP(ret);
+	if (fstat_getsize(fd, &u.size) < 0) POSIXERR_AND_JUMP(reclose);
+	u.sizestorage = check_signature(fd, &u);
+	if (u.sizestorage == 0) goto reclose;
+	if (get_ssb_dimensions(fd, &u) == false) goto reclose;
+	if (stackmem != NULL) {
+		if (check_ssb_dimensions(&u) == false) goto reclose;
+		if (msize != TSSB_CALCULATE_MMAP(u)) SERR_AND_JUMP(err_file_is_changed, reclose);
+	}
+	void *data;
+	if (IS_BIG_ENDIAN) data = mmap(NULL, u.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	else data = mmap(NULL, u.size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) POSIXERR_AND_JUMP(reclose);
+	close(fd);
+	u.source = data;
+	u.tablemem = stackmem;
+	u.flags = TSSB_MAPPED | TSSB_APART;
+	return u;
+
+	reclose: close(fd);
+	ret: return u;
+}
+
+#endif // SSB_POSIX_0
+
+void release_tssb(tssb *u) {
+	if (u->flags & TSSB_OWN_TABLE) free(u->tablemem);
+#if defined(SSB_POSIX_0)
+	if (u->flags & TSSB_MAPPED) munmap(u->source, u->size);
+#endif
+	if (u->flags & TSSB_OWN_SOURCE) free(u->source);
+	u->source = NULL;
+	u->tablemem = NULL;
+	u->flags = 0;
+}
+
+#if defined(SSB_POSIX_0)
 tssb check_tssb(const char *filename) {
 	tssb u = {.errreasonstr = NULL};
 
@@ -158,10 +259,79 @@ tssb check_tssb(const char *filename) {
 	if (fstat_getsize(fd, &u.size) < 0) POSIXERR_AND_JUMP(reclose);
 	u.sizestorage = check_signature(fd, &u);
 	if (u.sizestorage == 0) goto reclose;
-	get_ssb_dimensions(fd, &u);
+	if (get_ssb_dimensions(fd, &u)) check_ssb_dimensions(&u);
 	reclose: close(fd);
 	ret: return u;
 }
+#endif // SSB_POSIX_0
+
+static inline bool get_addr_dimensions(const char *source, tssb *u) {
+	// above
+	// Retrieve amount of cols and rows from TSSB object in memory
+
+	uint32_t rowncol[2];
+	size_t offset = strlen(signatures[u->sizestorage]);
+	if (u->size < offset + sizeof(rowncol)) {
+		u->errreasonstr = err_not_a_valid_tssb;
+		return false;
+	}
+	memcpy(rowncol, source + offset, sizeof(rowncol));
+	return set_ssb_dimensions(rowncol, u);
+}
+
+tssb check_tssb_addr(const void *source, size_t size) {
+	tssb u = {.errreasonstr = NULL, .size = size};
+
+	if (source == NULL) {
+		u.errreasonstr = err_not_a_valid_tssb;
+		return u;
+	}
+	u.sizestorage = match_signature(source, size, &u);
+	if (u.sizestorage == 0) return u;
+	if (get_addr_dimensions(source, &u)) check_ssb_dimensions(&u);
+	return u;
+}
+
+tssb prepare_tssb_addr(source_type t, const void *source, size_t size, void *stackmem, size_t msize) {
+	// above
+	// Just like prepare_tssb() and prepare_tssb_mmap(), but without any file I/O.
+
+	tssb u = {.errreasonstr = NULL, .size = size};
+
+	if (source == NULL) SERR_AND_JUMP(err_not_a_valid_tssb, ret);
+	u.sizestorage = match_signature(source, size, &u);
+	if (u.sizestorage == 0) return u;
+	if (get_addr_dimensions(source, &u) == false) return u;
+
+	switch (t) {
+	case SOURCE_ADDR:
+		if (check_ssb_dimensions(&u) == false) return u;
+		if (stackmem == NULL) {
+			stackmem = mcalloc(TSSB_CALCULATE(u));
+			if (stackmem == NULL) POSIXERR_AND_JUMP(ret);
+			u.flags = TSSB_OWN_SOURCE;
+		} else if (msize != TSSB_CALCULATE(u)) SERR_AND_JUMP(err_invalid_size, ret);
+		memcpy(stackmem, source, size);
+		u.source = stackmem;
+		return u;
+
+	case SOURCE_ADDR_INPLACE:
+		if (stackmem != NULL) {
+			if (check_ssb_dimensions(&u) == false) return u;
+			if (msize != TSSB_CALCULATE_MMAP(u)) SERR_AND_JUMP(err_invalid_size, ret);
+		}
+		u.source = (char *) source;
+		u.tablemem = stackmem;
+		u.flags = TSSB_APART;
+		return u;
+
+	default:
+		u.errreasonstr = err_unsupported_source;
+		return u;
+	}
+
+	ret: return u;
+}
 
 static inline void *alignto(void *addr, size_t alignment) {
 	// above
@@ -171,55 +341,129 @@ static inline void *alignto(void *addr, size_t alignment) {
 	return a;
 }
 
-static inline char ***set_2ndptrs(tssb u) {
+static inline char ***get_table(tssb u) {
 	// above
-	// Handy procedure that sets pointers for first dimension for twodimensional array. Sets last element of second
-	// dimension to NULL
+	// Retrieve address of twodimensional array
 
-	char ***t = (char ***) (u.source + u.size);
+	char ***t = (char ***) (u.tablemem != NULL ? u.tablemem : u.source + u.size);
 	// the address in t variable is not aligned. Read commends at SSB_ALIGN_FUCKING_POINTERS macro description if you
 	// want to know why i'm going to align it. Not because i'm byte spender or douchebag.
-	t = alignto(t, SSB_ALIGN_FUCKING_POINTERS);
+	return alignto(t, SSB_ALIGN_FUCKING_POINTERS);
+}
+
+static inline char ***set_2ndptrs(tssb u) {
+	// above
+	// Handy procedure that sets pointers for first dimension for twodimensional array. Second dimension is cleared
+	// by parse loop, row by row, when row is met, because table may be placed in caller's memory which isn't zeroed.
+
+	char ***t = get_table(u);
 	size_t rowscount = 0;
 
 	while(rowscount < u.rows) {
 		t[rowscount] = (char **) (t + u.rows + rowscount * (u.cols + 1));
-		t[rowscount][u.cols] = NULL;
 		rowscount++;
 	}
 
 	return t;
 }
 
+static bool reserve_table(tssb *p) {
+	// above
+	// Allocate space for pointer table if it's placed apart from source and user didn't pass it
+
+	if (p->tablemem != NULL or (p->flags & TSSB_APART) == 0) return true;
+	if (check_ssb_dimensions(p) == false) return false;
+	p->tablemem = mcalloc(TSSB_CALCULATE_MMAP(*p));
+	if (p->tablemem == NULL) {
+		p->errreasonstr = strerror(errno);
+		return false;
+	}
+	p->flags |= TSSB_OWN_TABLE;
+	return true;
+}
+
+#define DEFINE_PARSE_LOOP(bits) \
+static size_t parse_loop_u##bits(tssb u, char ***t, size_t currentpos, size_t *row, size_t until) { \
+	char **r = NULL; \
+	size_t b = 0; \
+	while(currentpos < u.size) { \
+		uint##bits##_t bsize; \
+		if (SSB_MALFORMED(u.size - currentpos < sizeof(bsize))) return SIZE_MAX; \
+		memcpy(&bsize, u.source + currentpos, sizeof(bsize)); \
+		if (bsize == UINT##bits##_MAX) { \
+			if (*row == until) return currentpos; \
+			if (*row >= u.rows) return SIZE_MAX; \
+			r = t[*row] = (char **) (t + u.rows + *row * (u.cols + 1)); \
+			memset(r, 0, (u.cols + 1) * sizeof(char *)); /* cells which are absent in short row are NULL */ \
+			(*row)++; \
+			b = 0; \
+			currentpos += sizeof(bsize); \
+			continue; \
+		} \
+		if (r == NULL or b >= u.cols) return SIZE_MAX; \
+		if (IS_BIG_ENDIAN) { \
+			bsize = bswap##bits##_priv_ssb(bsize); \
+			memcpy(u.source + currentpos, &bsize, sizeof(bsize)); \
+		} \
+		currentpos += sizeof(bsize); \
+		if (SSB_MALFORMED(bsize > u.size - currentpos)) return SIZE_MAX; \
+		r[b++] = u.source + currentpos; \
+		currentpos += bsize; \
+	} \
+	return currentpos; \
+}
+// above
+// Generates parse loop for one particular width of size field. Width is known at compile time, so memcpy() to
+// fixed width variable is a single unaligned load, and newline sigil check is a single integer comparison.
+// On big endian platforms sizes are swapped in place, so GETU**SSB macros are working there too.
+// Loop starts at newline sigil of *row and resolves rows until newline sigil of _until_ row is met. Position of that
+// sigil (or position of the end) is returned, and *row is the amount of rows which were started. SIZE_MAX means failure.
+// Size field which is cut by end of object and cell which is going beyond it are failures too. These checks are two
+// comparisons with values that are already in registers, so validating parse doesn't read anything twice.
+
+DEFINE_PARSE_LOOP(8)
+DEFINE_PARSE_LOOP(16)
+DEFINE_PARSE_LOOP(32)
+DEFINE_PARSE_LOOP(64)
+
+static size_t parse_rows(tssb u, char ***t, size_t currentpos, size_t *row, size_t until) {
+	switch (u.sizestorage) {
+	case sizeof(uint8_t): return parse_loop_u8(u, t, currentpos, row, until);
+	case sizeof(uint16_t): return parse_loop_u16(u, t, currentpos, row, until);
+	case sizeof(uint32_t): return parse_loop_u32(u, t, currentpos, row, until);
+	case sizeof(uint64_t): return parse_loop_u64(u, t, currentpos, row, until);
+	default: return SIZE_MAX;
+	}
+}
+
+static inline size_t first_row_position(tssb u) {
+	// above
+	// Retrieve position of first newline sigil, or 0 if there is no sigil.
+
+	const uint8_t newline_sigil[8] = {UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX};
+	size_t currentpos = strlen(signatures[u.sizestorage]) + sizeof(uint32_t) + sizeof(uint32_t);
+	if (u.size < currentpos + u.sizestorage) return 0;
+	if (memcmp(u.source + currentpos, newline_sigil, u.sizestorage) != 0) return 0;
+	return currentpos;
+}
+
 char ***parse_tssb(tssb *p) {
 	// above
 	// Evaluates parsing of TSSB object and points every pointer from twodimensional array to corresponding block.
 
 	if (p->errreasonstr != NULL) return NULL;
+	if (reserve_table(p) == false) return NULL;
 	tssb u = *p;
-	const uint8_t newline_sigil[8] = {UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX, UCHAR_MAX};
 	char ***t = set_2ndptrs(u);
-	size_t currentpos = strlen(signatures[u.sizestorage]) + sizeof(uint32_t) + sizeof(uint32_t);
-	if (memcmp(u.source + currentpos, newline_sigil, u.sizestorage) != 0) return NULL;
-	size_t bsize = 0, a = 0, b = 0; a--;
-
-	while(currentpos < u.size) {
-		if (memcmp(u.source + currentpos, newline_sigil, u.sizestorage) == 0) {
-			a++;
-			if (a >= u.rows) goto parse_failure;
-			currentpos += u.sizestorage;
-			b = 0;
-			continue;
-		}
-		if (b >= u.cols) goto parse_failure;
-		if (IS_BIG_ENDIAN) {
-			swapbytes_priv_ssb(u.source + currentpos, u.sizestorage);
-			memcpy((char *)  &bsize + (sizeof(size_t) - u.sizestorage), u.source + currentpos, u.sizestorage );
-		} else memcpy(&bsize, u.source + currentpos, u.sizestorage);
-		currentpos += u.sizestorage;
-		t[a][b++] = u.source + currentpos;
-		currentpos += bsize;
-	}
+	size_t currentpos = first_row_position(u);
+	if (currentpos == 0) return NULL;
+
+	size_t row = 0;
+	currentpos = parse_rows(u, t, currentpos, &row, u.rows);
+	if (currentpos == SIZE_MAX or currentpos < u.size) goto parse_failure;
+	for (; row < u.rows; row++) memset(t[row], 0, (u.cols + 1) * sizeof(char *)); // declared, but absent in data
+	p->resolved_rows = u.rows;
+	p->resolved_pos = currentpos;
 
 	return t;
 	parse_failure:
@@ -227,6 +471,910 @@ char ***parse_tssb(tssb *p) {
 	return NULL;
 }
 
+bool parse_tssb_lazy(tssb *p) {
+	// above
+	// Prepares everything for tssb_row() without touching any row.
+
+	if (p->errreasonstr != NULL) return false;
+	if (reserve_table(p) == false) return false;
+	p->resolved_rows = 0;
+	p->resolved_pos = first_row_position(*p);
+	if (p->resolved_pos == 0) {
+		p->errreasonstr = err_parse_fail;
+		return false;
+	}
+	return true;
+}
+
+char **tssb_row(tssb *p, size_t row) {
+	// above
+	// Returns already resolved row, or walks from first unresolved row to requested one. Rows which are on the
+	// way are resolved too, because it's required to read every size of them anyway.
+
+	char ***t = get_table(*p);
+	if (row < p->resolved_rows) return t[row];
+	if (row >= p->rows or p->resolved_pos >= p->size) return NULL;
+
+	size_t resolved = p->resolved_rows;
+	size_t currentpos = parse_rows(*p, t, p->resolved_pos, &resolved, row + 1);
+	if (currentpos == SIZE_MAX) {
+		p->errreasonstr = err_parse_fail;
+		return NULL;
+	}
+	if (resolved <= row) return NULL; // declared in header, but absent in data
+	p->resolved_rows = resolved;
+	p->resolved_pos = currentpos;
+	return t[row];
+}
+
+#define DEFINE_INDEX32_LOOP(bits) \
+static bool index32_loop_u##bits(tssb u, uint32_t *index, size_t currentpos) { \
+	uint32_t *r = NULL; \
+	size_t a = 0, b = 0; \
+	while(currentpos < u.size) { \
+		uint##bits##_t bsize; \
+		if (SSB_MALFORMED(u.size - currentpos < sizeof(bsize))) return false; \
+		memcpy(&bsize, u.source + currentpos, sizeof(bsize)); \
+		if (bsize == UINT##bits##_MAX) { \
+			if (a >= u.rows) return false; \
+			r = index + a++ * u.cols; \
+			b = 0; \
+			currentpos += sizeof(bsize); \
+			continue; \
+		} \
+		if (r == NULL or b >= u.cols) return false; \
+		if (IS_BIG_ENDIAN) { \
+			bsize = bswap##bits##_priv_ssb(bsize); \
+			memcpy(u.source + currentpos, &bsize, sizeof(bsize)); \
+		} \
+		currentpos += sizeof(bsize); \
+		if (SSB_MALFORMED(bsize > u.size - currentpos)) return false; \
+		r[b++] = (uint32_t) currentpos; \
+		currentpos += bsize; \
+	} \
+	return true; \
+}
+// above
+// Just like DEFINE_PARSE_LOOP, but generated loop walks whole table and fills compact index instead of pointers.
+
+DEFINE_INDEX32_LOOP(8)
+DEFINE_INDEX32_LOOP(16)
+DEFINE_INDEX32_LOOP(32)
+DEFINE_INDEX32_LOOP(64)
+
+uint32_t *index_tssb32(tssb *p, void *stackmem, size_t msize) {
+	// above
+	// Evaluates parsing of TSSB object into compact index. Offsets are fitting in 32 bits only if whole object does.
+
+	if (p->errreasonstr != NULL) return NULL;
+	tssb u = *p;
+	if (u.size > UINT32_MAX or u.rows > SIZE_MAX / sizeof(uint32_t) / u.cols) {
+		p->errreasonstr = err_out_of_table;
+		return NULL;
+	}
+	uint32_t *index = stackmem;
+	if (index == NULL) {
+		index = mcalloc(TSSB_CALCULATE_INDEX32(u));
+		if (index == NULL) {
+			p->errreasonstr = strerror(errno);
+			return NULL;
+		}
+	} else {
+		if (msize != TSSB_CALCULATE_INDEX32(u)) {
+			p->errreasonstr = err_invalid_size;
+			return NULL;
+		}
+		memset(index, 0, msize);
+	}
+
+	size_t currentpos = first_row_position(u);
+	bool success = false;
+	if (currentpos != 0) switch (u.sizestorage) {
+	case sizeof(uint8_t): success = index32_loop_u8(u, index, currentpos); break;
+	case sizeof(uint16_t): success = index32_loop_u16(u, index, currentpos); break;
+	case sizeof(uint32_t): success = index32_loop_u32(u, index, currentpos); break;
+	case sizeof(uint64_t): success = index32_loop_u64(u, index, currentpos); break;
+	}
+	if (success) return index;
+
+	if (stackmem == NULL) free(index);
+	p->errreasonstr = err_parse_fail;
+	return NULL;
+}
+
+static inline size_t cell_size(const char *cell, size_t width) {
+	// above
+	// Like getssbsize(), but width is one of four constants, so every case is a single load.
+
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+	uint64_t u64;
+	switch (width) {
+	case sizeof(uint8_t): memcpy(&u8, cell - sizeof(u8), sizeof(u8)); return u8;
+	case sizeof(uint16_t): memcpy(&u16, cell - sizeof(u16), sizeof(u16)); return u16;
+	case sizeof(uint32_t): memcpy(&u32, cell - sizeof(u32), sizeof(u32)); return u32;
+	default: memcpy(&u64, cell - sizeof(u64), sizeof(u64)); return u64;
+	}
+}
+
+static inline const void *table_slot(tssb *p, const uint32_t *index, tssb_cell_ref ref) {
+	// above
+	// Where pointer to cell is stored, if its row is already resolved. That's what is prefetched first.
+
+	(void) index;
+	return ref.row < p->resolved_rows and ref.col < p->cols ? &get_table(*p)[ref.row][ref.col] : NULL;
+}
+
+static inline const char *table_peek(tssb *p, const uint32_t *index, tssb_cell_ref ref) {
+	// above
+	// Cell of already resolved row. Never parses, so prefetching doesn't move lazy parsing ahead of requests.
+
+	char *const *slot = table_slot(p, index, ref);
+	return slot != NULL ? *slot : NULL;
+}
+
+static inline const char *table_cell(tssb *p, const uint32_t *index, tssb_cell_ref ref) {
+	(void) index;
+	if (ref.col >= p->cols) return NULL;
+	char **r = ref.row < p->resolved_rows ? get_table(*p)[ref.row] : tssb_row(p, ref.row);
+	return r != NULL ? r[ref.col] : NULL;
+}
+
+static inline const void *index32_slot(tssb *p, const uint32_t *index, tssb_cell_ref ref) {
+	return ref.row < p->rows and ref.col < p->cols ? index + (size_t) ref.row * p->cols + ref.col : NULL;
+}
+
+static inline const char *index32_cell(tssb *p, const uint32_t *index, tssb_cell_ref ref) {
+	const uint32_t *slot = index32_slot(p, index, ref);
+	return slot != NULL and *slot != 0 ? p->source + *slot : NULL;
+}
+
+#define DEFINE_GATHER(name, slot, peek, locate, out_type, data_member, size_member) \
+static size_t name(tssb *p, const uint32_t *index, const tssb_cell_ref *refs, size_t amount, out_type *out) { \
+	size_t total = 0; \
+	bool inside = true; \
+	for (size_t i = 0; i < amount; i++) { \
+		if (i + 2 * TSSB_GATHER_DISTANCE < amount) { \
+			const void *far = slot(p, index, refs[i + 2 * TSSB_GATHER_DISTANCE]); \
+			if (far != NULL) SSB_PREFETCH(far); \
+		} \
+		if (i + TSSB_GATHER_DISTANCE < amount) { \
+			const char *near = peek(p, index, refs[i + TSSB_GATHER_DISTANCE]); \
+			if (near != NULL) SSB_PREFETCH(near - p->sizestorage); \
+		} \
+		const char *cell = locate(p, index, refs[i]); \
+		size_t size = cell != NULL ? cell_size(cell, p->sizestorage) : 0; \
+		inside &= slot(p, index, refs[i]) != NULL; \
+		out[i].data_member = (void *) cell; \
+		out[i].size_member = size; \
+		total += size; \
+	} \
+	return inside ? total : SIZE_MAX; \
+}
+// above
+// Generates gather loop for one kind of table and one kind of output. Lookup of every cell is a chain of dependent
+// loads: slot of table, then size field of cell. So slot is prefetched 2 * TSSB_GATHER_DISTANCE cells ahead, and
+// size field is prefetched TSSB_GATHER_DISTANCE cells ahead, when slot is (hopefully) in cache already. Only rows
+// which are resolved already are prefetched. After locate(), slot exists only if ref is inside table and its row
+// was resolved, so failed lazy parsing fails whole call.
+
+DEFINE_GATHER(gather_table_view, table_slot, table_peek, table_cell, tssb_cell_view, data, size)
+DEFINE_GATHER(gather_index32_view, index32_slot, index32_cell, index32_cell, tssb_cell_view, data, size)
+
+size_t gather_tssb(tssb *p, const tssb_cell_ref *refs, size_t amount, tssb_cell_view *out) {
+	return gather_table_view(p, NULL, refs, amount, out);
+}
+
+size_t gather_tssb32(tssb *p, const uint32_t *index, const tssb_cell_ref *refs, size_t amount, tssb_cell_view *out) {
+	return gather_index32_view(p, index, refs, amount, out);
+}
+
+#if defined(SSB_POSIX_0)
+DEFINE_GATHER(gather_table_iovec, table_slot, table_peek, table_cell, struct iovec, iov_base, iov_len)
+DEFINE_GATHER(gather_index32_iovec, index32_slot, index32_cell, index32_cell, struct iovec, iov_base, iov_len)
+
+size_t gather_tssb_iovec(tssb *p, const tssb_cell_ref *refs, size_t amount, struct iovec *iov) {
+	return gather_table_iovec(p, NULL, refs, amount, iov);
+}
+
+size_t gather_tssb32_iovec(tssb *p, const uint32_t *index, const tssb_cell_ref *refs, size_t amount, struct iovec *iov) {
+	return gather_index32_iovec(p, index, refs, amount, iov);
+}
+#endif // SSB_POSIX_0
+
+#if defined(SSB_POSIX_0)
+const char tssb_shared_signature[16] = "SSBSHAREDINDEX0";
+
+struct tssb_shared_format {
+	char signature[sizeof(tssb_shared_signature)];
+	uint32_t byte_order; // 0x01020304 in native order of producer, because sizes and index are native there
+	uint32_t sizestorage;
+	uint64_t rows;
+	uint64_t cols;
+	uint64_t size; // size of tssb object, which is placed right after this header
+	uint64_t index_offset; // where compact index begins, from beginning of segment
+	char source[];
+};
+
+static bool write_all(int fd, const void *data, size_t size) {
+	const char *p = data;
+	while (size > 0) {
+		ssize_t got = write(fd, p, size);
+		if (got < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		p += got;
+		size -= (size_t) got;
+	}
+	return true;
+}
+
+bool share_tssb(tssb *p, int fd) {
+	// above
+	// Layout is written sequentially, so fd may be anything writable: memfd, shm_open() object or regular file.
+
+	uint32_t *index = index_tssb32(p, NULL, 0);
+	if (index == NULL) return false;
+
+	struct tssb_shared_format header = {.byte_order = 0x01020304, .sizestorage = p->sizestorage, .rows = p->rows,
+		.cols = p->cols, .size = p->size};
+	memcpy(header.signature, tssb_shared_signature, sizeof(tssb_shared_signature));
+	size_t residue = (sizeof(uint32_t) - p->size % sizeof(uint32_t)) % sizeof(uint32_t);
+	header.index_offset = sizeof(header) + p->size + residue;
+
+	const char padding[sizeof(uint32_t)] = {0};
+	bool success = write_all(fd, &header, sizeof(header)) and write_all(fd, p->source, p->size) and
+		write_all(fd, padding, residue) and write_all(fd, index, TSSB_CALCULATE_INDEX32(*p));
+	free(index);
+	if (success == false) p->errreasonstr = strerror(errno);
+	return success;
+}
+
+tssb_shared attach_tssb_shared(int fd) {
+	tssb_shared s = {.errreasonstr = NULL};
+
+	size_t size;
+	if (fstat_getsize(fd, &size) < 0) {
+		s.errreasonstr = strerror(errno);
+		return s;
+	}
+	if (size < sizeof(struct tssb_shared_format)) {
+		s.errreasonstr = err_not_a_valid_tssb;
+		return s;
+	}
+	struct tssb_shared_format *format = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (format == MAP_FAILED) {
+		s.errreasonstr = strerror(errno);
+		return s;
+	}
+
+	// offsets inside index are trusted, it's producer's job to build it. Only layout itself is checked
+	if (memcmp(format->signature, tssb_shared_signature, sizeof(tssb_shared_signature)) != 0 or
+		format->byte_order != 0x01020304 or format->sizestorage > sizeof(uint64_t) or
+		signatures[format->sizestorage] == &empty_string or format->size > UINT32_MAX or format->rows > UINT32_MAX or
+		format->cols > UINT32_MAX or format->index_offset % sizeof(uint32_t) or
+		format->index_offset < sizeof(struct tssb_shared_format) + format->size or
+		format->index_offset > size or (format->cols and
+		format->rows > (size - format->index_offset) / sizeof(uint32_t) / format->cols)) {
+		munmap(format, size);
+		s.errreasonstr = err_not_a_valid_tssb;
+		return s;
+	}
+
+	s.u.source = format->source;
+	s.u.size = format->size;
+	s.u.rows = format->rows;
+	s.u.cols = format->cols;
+	s.u.sizestorage = format->sizestorage;
+	s.index = (const void *) ((const char *) format + format->index_offset);
+	s.segment = format;
+	s.segment_size = size;
+	return s;
+}
+#endif // SSB_POSIX_0
+
+void detach_tssb_shared(tssb_shared *s) {
+	if (s->flags & TSSB_SHARED_OWN_INDEX) free((void *) s->index);
+	release_tssb(&s->u);
+#if defined(SSB_POSIX_0)
+	if (s->segment != NULL) munmap(s->segment, s->segment_size);
+#endif
+	memset(s, 0, sizeof(tssb_shared));
+}
+
+static bool check_indexed_offsets(tssb u, const uint32_t *index) {
+	// above
+	// Every offset must point after first newline sigil and size field, and its payload must fit in object, just
+	// like in check_pooled(). Only size fields are read, payload itself is not touched.
+
+	size_t minimal = first_row_position(u) + u.sizestorage * 2, cellsize;
+	if (minimal == u.sizestorage * 2) return false;
+	bool valid = true;
+	for (size_t i = 0; i < u.rows * u.cols and valid; i++) {
+		valid = index[i] == 0 or (index[i] >= minimal and index[i] <= u.size and
+			getssbsize(u.source + index[i], u, &cellsize) <= u.size - index[i]);
+	}
+	return valid;
+}
+
+static bool check_pooled(tssb *u, char *base, size_t size, uint32_t *index) {
+	// above
+	// Pooled variant has no embedded tssb object: offsets are pointing into pool of distinct cells, which goes right
+	// after offset table. Every pool entry must fit in object, and every offset must point to payload whose size
+	// field fits too. Sizes and offsets are little endian, so big endian platforms are swapping them in place.
+
+	size_t width = (unsigned char) base[TSSB_POOLED_SIZESTORAGE];
+	size_t pool = TSSB_INDEXED_HEADER + u->rows * u->cols * sizeof(uint32_t);
+	if (width > sizeof(uint64_t) or signatures[width] == &empty_string or size > UINT32_MAX) {
+		u->errreasonstr = err_not_a_valid_tssb;
+		return false;
+	}
+	u->sizestorage = width;
+	bool valid = true;
+	for (size_t at = pool; at < size and valid; ) {
+		valid = width <= size - at;
+		if (valid == false) break;
+		uint64_t cell = get_le(base + at, width);
+		if (IS_BIG_ENDIAN) memcpy(base + at, (char *) &cell + sizeof(cell) - width, width);
+		at += width;
+		valid = cell <= size - at;
+		at += valid ? cell : 0;
+	}
+	size_t cells = u->rows * u->cols;
+	if (IS_BIG_ENDIAN and valid) bswap32_bulk_priv_ssb(index, index, cells);
+	size_t minimal = pool + width, cellsize;
+	for (size_t i = 0; i < cells and valid; i++) {
+		valid = index[i] == 0 or (index[i] >= minimal and index[i] <= size and
+			getssbsize(base + index[i], *u, &cellsize) <= size - index[i]);
+	}
+	if (valid == false) u->errreasonstr = err_not_a_valid_tssb;
+	return valid;
+}
+
+static bool open_indexed(tssb *u, char *base, size_t size, uint32_t **index) {
+	// above
+	// Checks pre-indexed or pooled object of _size_ bytes at _base_, and fills _u_ so that TSSB_CELL32() works
+	// with _index_. Big endian platforms are writing swapped sizes and offsets into _base_.
+
+	bool pooled = memcmp(base, tssb_signature_pooled, strizeof(tssb_signature_pooled)) == 0;
+	uint32_t rowncol[2];
+	memcpy(rowncol, base + strizeof(tssb_signature_indexed), sizeof(rowncol));
+	if (set_ssb_dimensions(rowncol, u) == false) return false;
+	size_t rows = u->rows, cols = u->cols;
+	if (rows > (size - TSSB_INDEXED_HEADER) / sizeof(uint32_t) / cols) {
+		u->errreasonstr = err_not_a_valid_tssb;
+		return false;
+	}
+	size_t index_size = rows * cols * sizeof(uint32_t);
+	*index = (void *) (base + TSSB_INDEXED_HEADER);
+	if (pooled) {
+		if (check_pooled(u, base, size, *index) == false) return false;
+		u->source = base;
+		u->size = size;
+		return true;
+	}
+
+	char *object = base + TSSB_INDEXED_HEADER + index_size;
+	u->size = size - TSSB_INDEXED_HEADER - index_size;
+	u->sizestorage = match_signature(object, u->size, u);
+	if (u->sizestorage == 0 or get_addr_dimensions(object, u) == false) return false;
+	if (u->rows != rows or u->cols != cols or u->size > UINT32_MAX) {
+		u->errreasonstr = err_not_a_valid_tssb;
+		return false;
+	}
+	u->source = object;
+
+	// offsets and sizes are little endian, so big endian platforms have to build index by themselves
+	if (IS_BIG_ENDIAN) return index_tssb32(u, *index, index_size) != NULL;
+	if (check_indexed_offsets(*u, *index)) return true;
+	u->errreasonstr = err_not_a_valid_tssb;
+	return false;
+}
+
+static inline bool is_indexed(const char *header, size_t size) {
+	return size >= TSSB_INDEXED_HEADER and (memcmp(header, tssb_signature_indexed, strizeof(tssb_signature_indexed)) == 0 or
+		memcmp(header, tssb_signature_pooled, strizeof(tssb_signature_pooled)) == 0);
+}
+
+#if defined(SSB_POSIX_0)
+static tssb_shared fallback_to_legacy(const char *filename) {
+	// above
+	// Regular TSSB file has no offset table, so it has to be indexed right now.
+
+	tssb_shared s = {.errreasonstr = NULL};
+	s.u = prepare_tssb_mmap(filename, NULL, 0);
+	if (s.u.errreasonstr == NULL) s.index = index_tssb32(&s.u, NULL, 0);
+	if (s.index == NULL) {
+		s.errreasonstr = s.u.errreasonstr;
+		release_tssb(&s.u);
+		return s;
+	}
+	s.flags = TSSB_SHARED_OWN_INDEX;
+	return s;
+}
+
+tssb_shared prepare_tssb_indexed(const char *filename) {
+	tssb_shared s = {.errreasonstr = NULL};
+	tssb u = {.errreasonstr = NULL};
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) POSIXERR_AND_JUMP(ret);
+	if (fstat_getsize(fd, &s.segment_size) < 0) POSIXERR_AND_JUMP(reclose);
+	char header[TSSB_INDEXED_HEADER];
+	ssize_t got = nposix_pread(fd, header, sizeof(header), 0);
+	if (got < 0) POSIXERR_AND_JUMP(reclose);
+	if (is_indexed(header, (size_t) got) == false) {
+		close(fd);
+		return fallback_to_legacy(filename);
+	}
+
+	if (IS_BIG_ENDIAN) s.segment = mmap(NULL, s.segment_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	else s.segment = mmap(NULL, s.segment_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (s.segment == MAP_FAILED) {
+		s.segment = NULL;
+		POSIXERR_AND_JUMP(reclose);
+	}
+	close(fd);
+
+	uint32_t *index;
+	if (open_indexed(&u, s.segment, s.segment_size, &index) == false) {
+		munmap(s.segment, s.segment_size);
+		s.segment = NULL;
+		goto ret;
+	}
+	s.index = index;
+	s.u = u;
+	return s;
+
+	reclose: close(fd);
+	ret: s.errreasonstr = u.errreasonstr;
+	return s;
+}
+#endif // SSB_POSIX_0
+
+tssb_shared prepare_tssb_indexed_addr(void *source, size_t size) {
+	tssb_shared s = {.errreasonstr = NULL};
+	if (is_indexed(source, size) == false) {
+		s.u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, source, size, NULL, 0);
+		if (s.u.errreasonstr == NULL) s.index = index_tssb32(&s.u, NULL, 0);
+		if (s.index == NULL) {
+			s.errreasonstr = s.u.errreasonstr;
+			release_tssb(&s.u);
+			return s;
+		}
+		s.flags = TSSB_SHARED_OWN_INDEX;
+		return s;
+	}
+	uint32_t *index;
+	if (open_indexed(&s.u, source, size, &index) == false) {
+		s.errreasonstr = s.u.errreasonstr;
+		memset(&s.u, 0, sizeof(s.u));
+		return s;
+	}
+	s.index = index;
+	return s;
+}
+
+size_t check_tssb_hash(const tssb *u) {
+	size_t buckets = 2;
+	while (buckets < u->rows * 2) buckets *= 2; // load factor is not above 0.5
+	return buckets * sizeof(uint32_t);
+}
+
+static inline bool same_cell(tssb *p, const tssb_hash *h, size_t row, const void *key, size_t size) {
+	char *cell = tssb_row(p, row)[h->col];
+	size_t cellsize;
+	return cell != NULL and getssbsize(cell, *p, &cellsize) == size and memcmp(cell, key, size) == 0;
+}
+
+tssb_hash hash_tssb(tssb *p, size_t col, void *stackmem, size_t msize) {
+	tssb_hash h = {.col = col};
+	if (p->errreasonstr != NULL) return h;
+	if (col >= p->cols or p->rows > UINT32_MAX) {
+		p->errreasonstr = err_out_of_table;
+		return h;
+	}
+	size_t required = check_tssb_hash(p);
+	uint32_t *buckets = stackmem;
+	if (buckets == NULL) {
+		buckets = malloc(required);
+		if (buckets == NULL) {
+			p->errreasonstr = strerror(errno);
+			return h;
+		}
+	} else if (msize != required) {
+		p->errreasonstr = err_invalid_size;
+		return h;
+	}
+	memset(buckets, 0, required);
+	h.size = required / sizeof(uint32_t);
+
+	for (size_t row = 0; row < p->rows; row++) {
+		char **r = tssb_row(p, row);
+		if (r == NULL) {
+			if (p->errreasonstr != NULL) goto failure;
+			break; // declared in header, but absent in data
+		}
+		if (r[col] == NULL) continue;
+		size_t size;
+		getssbsize(r[col], *p, &size);
+		size_t b = hash_priv_ssb(r[col], size) & (h.size - 1);
+		while (buckets[b] != 0) {
+			if (same_cell(p, &h, buckets[b] - 1, r[col], size)) break;
+			b = (b + 1) & (h.size - 1);
+		}
+		if (buckets[b] == 0) buckets[b] = row + 1;
+	}
+	h.buckets = buckets;
+	return h;
+
+	failure:
+	if (stackmem == NULL) free(buckets);
+	return h;
+}
+
+size_t find_tssb_row(tssb *p, const tssb_hash *h, const void *key, size_t size) {
+	size_t b = hash_priv_ssb(key, size) & (h->size - 1);
+	while (h->buckets[b] != 0) {
+		if (same_cell(p, h, h->buckets[b] - 1, key, size)) return h->buckets[b] - 1;
+		b = (b + 1) & (h->size - 1);
+	}
+	return TSSB_NO_ROW;
+}
+
+#if defined(SSB_POSIX_0)
+typedef struct {
+	int fd;
+	char *buffer;
+	size_t capacity; // how much bytes buffer can hold
+	size_t length; // how much bytes are in buffer
+	size_t pos; // how much bytes of them are already consumed
+} stream_state;
+
+static bool stream_need(stream_state *st, size_t amount, tssb *u) {
+	// above
+	// Make sure that at least _amount_ unconsumed bytes are in buffer. Buffer grows only if one piece of data
+	// (size field and cell) doesn't fit into it. Returns false on error or if stream is over.
+
+	while (st->length - st->pos < amount) {
+		memmove(st->buffer, st->buffer + st->pos, st->length - st->pos);
+		st->length -= st->pos;
+		st->pos = 0;
+		if (st->capacity < amount) {
+			char *grown = realloc(st->buffer, amount);
+			if (grown == NULL) {
+				u->errreasonstr = strerror(errno);
+				return false;
+			}
+			st->buffer = grown;
+			st->capacity = amount;
+		}
+		ssize_t got = read(st->fd, st->buffer + st->length, st->capacity - st->length);
+		if (got < 0 and errno == EINTR) continue;
+		if (got < 0) {
+			u->errreasonstr = strerror(errno);
+			return false;
+		}
+		if (got == 0) return false;
+		st->length += got;
+	}
+	return true;
+}
+
+tssb stream_tssb(int fd, size_t chunk, tssb_cell_callback callback, void *ctx) {
+	// above
+	// Walks TSSB object from file descriptor once, without knowing its size. Memory usage is bounded by _chunk_
+	// and the largest cell.
+
+	tssb u = {.errreasonstr = NULL};
+	const size_t header = strizeof(tssb_signature_08bit) + 2 * sizeof(uint32_t);
+	stream_state st = {.fd = fd, .capacity = chunk < header ? header : chunk};
+	st.buffer = malloc(st.capacity);
+	if (st.buffer == NULL) POSIXERR_AND_JUMP(ret);
+
+	if (stream_need(&st, header, &u) == false) {
+		if (u.errreasonstr == NULL) u.errreasonstr = err_not_a_valid_tssb;
+		goto refree;
+	}
+	u.sizestorage = match_signature(st.buffer, header, &u);
+	if (u.sizestorage == 0) goto refree;
+	uint32_t rowncol[2];
+	memcpy(rowncol, st.buffer + strlen(signatures[u.sizestorage]), sizeof(rowncol));
+	if (set_ssb_dimensions(rowncol, &u) == false) goto refree;
+	st.pos = header;
+	u.size = header;
+
+	const uint64_t sigil = u.sizestorage == sizeof(uint64_t) ? UINT64_MAX : (UINT64_C(1) << u.sizestorage * CHAR_BIT) - 1;
+	size_t row = 0, col = 0;
+	while (stream_need(&st, u.sizestorage, &u)) {
+		uint64_t bsize = 0;
+		memcpy(&bsize, st.buffer + st.pos, u.sizestorage);
+		if (IS_BIG_ENDIAN) bsize = bswap64_priv_ssb(bsize);
+		if (bsize == sigil) {
+			if (row >= u.rows) SERR_AND_JUMP(err_parse_fail, refree);
+			row++;
+			col = 0;
+			st.pos += u.sizestorage;
+			u.size += u.sizestorage;
+			continue;
+		}
+		if (row == 0 or col >= u.cols or bsize > SIZE_MAX - u.sizestorage) SERR_AND_JUMP(err_parse_fail, refree);
+		if (stream_need(&st, u.sizestorage + bsize, &u) == false) {
+			if (u.errreasonstr == NULL) u.errreasonstr = err_parse_fail; // truncated cell
+			goto refree;
+		}
+		if (callback(ctx, row - 1, col, st.buffer + st.pos + u.sizestorage, bsize) == false) goto refree;
+		col++;
+		st.pos += u.sizestorage + bsize;
+		u.size += u.sizestorage + bsize;
+	}
+	if (u.errreasonstr == NULL and st.length != st.pos) u.errreasonstr = err_parse_fail; // truncated size
+
+	refree: free(st.buffer);
+	ret: return u;
+}
+#endif // SSB_POSIX_0
+
+#define BUILDER_NEW_ROW SIZE_MAX // arena record which means new row instead of cell size
+
+static bool arena_append(tssb_builder *b, size_t header, const void *data, size_t size) {
+	// above
+	// Append record to arena: header (size of cell or BUILDER_NEW_ROW) and cell itself.
+
+	size_t required = sizeof(header) + size;
+	if (size > SIZE_MAX - sizeof(header) or b->arena_size > SIZE_MAX - required) {
+		b->errreasonstr = err_out_of_table;
+		return false;
+	}
+	if (b->arena_size + required > b->arena_capacity) {
+		size_t capacity = b->arena_capacity ? b->arena_capacity : 4096;
+		while (capacity < b->arena_size + required) capacity = capacity > SIZE_MAX / 2 ? b->arena_size + required : capacity * 2;
+		char *grown = realloc(b->arena, capacity);
+		if (grown == NULL) {
+			b->errreasonstr = strerror(errno);
+			return false;
+		}
+		b->arena = grown;
+		b->arena_capacity = capacity;
+	}
+	memcpy(b->arena + b->arena_size, &header, sizeof(header));
+	if (size > 0) memcpy(b->arena + b->arena_size + sizeof(header), data, size);
+	b->arena_size += required;
+	return true;
+}
+
+bool add_tssb_row(tssb_builder *b) {
+	if (b->errreasonstr != NULL) return false;
+	if (b->rows >= UINT32_MAX) {
+		b->errreasonstr = err_out_of_table;
+		return false;
+	}
+	if (arena_append(b, BUILDER_NEW_ROW, NULL, 0) == false) return false;
+	b->rows++;
+	b->current_cols = 0;
+	return true;
+}
+
+bool add_tssb_cell(tssb_builder *b, const void *data, size_t size) {
+	if (b->errreasonstr != NULL) return false;
+	if (b->rows == 0 or b->current_cols >= UINT32_MAX or (uint64_t) size >= UINT64_MAX) {
+		b->errreasonstr = b->rows == 0 ? err_empty_builder : err_out_of_table;
+		return false;
+	}
+	if (arena_append(b, size, data, size) == false) return false;
+	b->cells++;
+	b->current_cols++;
+	if (b->current_cols > b->cols) b->cols = b->current_cols;
+	if (size > b->largest) b->largest = size;
+	return true;
+}
+
+static size_t builder_sizestorage(const tssb_builder *b) {
+	// above
+	// The narrowest size field that fits the largest cell. Maximum value of size field is newline sigil.
+
+	if (b->largest < UINT8_MAX) return sizeof(uint8_t);
+	if (b->largest < UINT16_MAX) return sizeof(uint16_t);
+	if (b->largest < UINT32_MAX) return sizeof(uint32_t);
+	return sizeof(uint64_t);
+}
+
+static inline void put_le(char *dst, uint64_t value, size_t width) {
+	// above
+	// Stores _width_ lowest bytes of value in little endian order.
+
+	for (size_t i = 0; i < width; i++) {
+		dst[i] = (char) (value & UCHAR_MAX);
+		value >>= CHAR_BIT;
+	}
+}
+
+struct pool_entry {
+	const char *record; // first cell with such payload, in arena
+	size_t offset; // where its payload is placed in pooled variant
+};
+
+static bool intern_cells(tssb_builder *b, size_t width, char *object, size_t *pool_size) {
+	// above
+	// Walks arena and places every distinct payload in pool once, with size field before it. Identical cells are
+	// getting offset of the same payload. If _object_ is NULL, only size of pool is calculated.
+
+	size_t buckets = 2;
+	while (buckets < b->cells * 2) buckets *= 2; // load factor is not above 0.5
+	struct pool_entry *table = calloc(buckets, sizeof(struct pool_entry));
+	if (table == NULL) {
+		b->errreasonstr = strerror(errno);
+		return false;
+	}
+	size_t base = TSSB_INDEXED_HEADER + b->rows * b->cols * sizeof(uint32_t);
+	const char *record = b->arena;
+	const char *end = b->arena + b->arena_size;
+	size_t cell = 0, row_end = 0;
+	*pool_size = 0;
+	while (record < end) {
+		size_t header;
+		memcpy(&header, record, sizeof(header));
+		record += sizeof(header);
+		if (header == BUILDER_NEW_ROW) {
+			cell = row_end;
+			row_end += b->cols;
+			continue;
+		}
+		size_t h = hash_priv_ssb(record, header) & (buckets - 1);
+		for (; table[h].record != NULL; h = (h + 1) & (buckets - 1)) {
+			size_t size;
+			memcpy(&size, table[h].record - sizeof(size), sizeof(size));
+			if (size == header and memcmp(table[h].record, record, header) == 0) break;
+		}
+		if (table[h].record == NULL) {
+			table[h].record = record;
+			table[h].offset = base + *pool_size + width;
+			if (object != NULL) {
+				put_le(object + base + *pool_size, header, width);
+				memcpy(object + table[h].offset, record, header);
+			}
+			*pool_size += width + header;
+		}
+		if (object != NULL) put_le(object + TSSB_INDEXED_HEADER + cell * sizeof(uint32_t), table[h].offset, sizeof(uint32_t));
+		cell++;
+		record += header;
+	}
+	free(table);
+	return true;
+}
+
+static size_t calculate_pooled_build(tssb_builder *b, size_t width) {
+	// above
+	// Offsets of pooled variant are 32 bit, so whole object must fit in 4GB.
+
+	size_t pool_size;
+	if (b->rows > (UINT32_MAX - TSSB_INDEXED_HEADER) / sizeof(uint32_t) / b->cols) {
+		b->errreasonstr = err_out_of_table;
+		return 0;
+	}
+	if (intern_cells(b, width, NULL, &pool_size) == false) return 0;
+	size_t total = TSSB_INDEXED_HEADER + b->rows * b->cols * sizeof(uint32_t);
+	if (pool_size > UINT32_MAX - total) {
+		b->errreasonstr = err_out_of_table;
+		return 0;
+	}
+	return total + pool_size;
+}
+
+size_t calculate_tssb_build(tssb_builder *b) {
+	if (b->errreasonstr != NULL) return 0;
+	if (b->rows == 0 or b->cols == 0) {
+		b->errreasonstr = err_empty_builder;
+		return 0;
+	}
+	size_t width = builder_sizestorage(b);
+	if (b->options & TSSB_BUILD_POOLED) return calculate_pooled_build(b, width);
+	size_t records = b->rows + b->cells;
+	// every arena record has size_t header, result has size field (or newline sigil) of chosen width instead
+	size_t body = b->arena_size - records * sizeof(size_t);
+	if (records > (SIZE_MAX - body) / width) {
+		b->errreasonstr = err_out_of_table;
+		return 0;
+	}
+	size_t total = strlen(signatures[width]) + sizeof(uint32_t) * 2 + body + records * width;
+	if (b->options & TSSB_BUILD_INDEXED) {
+		// offsets of pre-indexed variant are 32 bit
+		if (total > UINT32_MAX or b->rows > (SIZE_MAX - total - TSSB_INDEXED_HEADER) / sizeof(uint32_t) / b->cols) {
+			b->errreasonstr = err_out_of_table;
+			return 0;
+		}
+		total += TSSB_INDEXED_HEADER + b->rows * b->cols * sizeof(uint32_t);
+	}
+	return total;
+}
+
+size_t build_tssb(tssb_builder *b, void *buffer, size_t size) {
+	size_t total = calculate_tssb_build(b);
+	if (total == 0) return 0;
+	if (size < total) {
+		b->errreasonstr = err_invalid_size;
+		return 0;
+	}
+
+	size_t width = builder_sizestorage(b);
+	char *out = buffer;
+	if (b->options & TSSB_BUILD_POOLED) {
+		memset(out, 0, TSSB_INDEXED_HEADER + b->rows * b->cols * sizeof(uint32_t)); // absent cells are 0
+		memcpy(out, tssb_signature_pooled, strizeof(tssb_signature_pooled));
+		put_le(out + strizeof(tssb_signature_pooled), b->rows, sizeof(uint32_t));
+		put_le(out + strizeof(tssb_signature_pooled) + sizeof(uint32_t), b->cols, sizeof(uint32_t));
+		out[TSSB_POOLED_SIZESTORAGE] = (char) width;
+		size_t pool_size;
+		return intern_cells(b, width, out, &pool_size) ? total : 0;
+	}
+	char *index = NULL;
+	if (b->options & TSSB_BUILD_INDEXED) {
+		memset(out, 0, TSSB_INDEXED_HEADER + b->rows * b->cols * sizeof(uint32_t)); // absent cells are 0
+		memcpy(out, tssb_signature_indexed, strizeof(tssb_signature_indexed));
+		put_le(out + strizeof(tssb_signature_indexed), b->rows, sizeof(uint32_t));
+		put_le(out + strizeof(tssb_signature_indexed) + sizeof(uint32_t), b->cols, sizeof(uint32_t));
+		index = out + TSSB_INDEXED_HEADER;
+		out = index + b->rows * b->cols * sizeof(uint32_t);
+	}
+	const char *object = out;
+	size_t length = strlen(signatures[width]);
+	memcpy(out, signatures[width], length);
+	out += length;
+	put_le(out, b->rows, sizeof(uint32_t));
+	put_le(out + sizeof(uint32_t), b->cols, sizeof(uint32_t));
+	out += sizeof(uint32_t) * 2;
+
+	uint64_t sigil = width == sizeof(uint64_t) ? UINT64_MAX : (UINT64_C(1) << (width * CHAR_BIT)) - 1;
+	const char *record = b->arena;
+	const char *end = b->arena + b->arena_size;
+	size_t cell = 0; // position in offset table of pre-indexed variant
+	size_t row_end = 0;
+	while (record < end) {
+		size_t header;
+		memcpy(&header, record, sizeof(header));
+		record += sizeof(header);
+		if (header == BUILDER_NEW_ROW) {
+			put_le(out, sigil, width);
+			out += width;
+			cell = row_end;
+			row_end += b->cols;
+			continue;
+		}
+		put_le(out, header, width);
+		out += width;
+		if (index) put_le(index + cell++ * sizeof(uint32_t), out - object, sizeof(uint32_t));
+		memcpy(out, record, header);
+		out += header;
+		record += header;
+	}
+
+	return total;
+}
+
+#if defined(SSB_POSIX_0)
+bool write_tssb(tssb_builder *b, int fd) {
+	size_t total = calculate_tssb_build(b);
+	if (total == 0) return false;
+	char *buffer = malloc(total);
+	if (buffer == NULL) {
+		b->errreasonstr = strerror(errno);
+		return false;
+	}
+	build_tssb(b, buffer, total);
+	bool success = write_all(fd, buffer, total);
+	if (success == false) b->errreasonstr = strerror(errno);
+	free(buffer);
+	return success;
+}
+#endif // SSB_POSIX_0
+
+void release_tssb_builder(tssb_builder *b) {
+	free(b->arena);
+	memset(b, 0, sizeof(tssb_builder));
+}
+
 size_t getssbsize(void *cell, tssb u, size_t *var) {
 	cell = (char *) cell - u.sizestorage;
 	*var = 0;
@@ -28,9 +28,17 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
-unsigned long max_acceptable_dimension_size = 150; // how BIG any tssb table dimension could be? Modify it if you need.
+unsigned long max_acceptable_dimension_size = 150; // how BIG any tssb table dimension could be? Modify it if you need. Compact index ignores it
 #define TSSB_CALCULATE(structure) (8 + structure.size + structure.rows * sizeof(void *) + (structure.cols + 1) * structure.rows * sizeof(void *))
+#define TSSB_CALCULATE_INDEX32(structure) ((structure).rows * (structure).cols * sizeof(uint32_t))
+#define TSSB_CALCULATE_MMAP(structure) (8 + (structure).rows * sizeof(void *) + ((structure).cols + 1) * (structure).rows * sizeof(void *))
+
+#ifndef SSB_SOURCE_TYPE
+#define SSB_SOURCE_TYPE
+typedef enum {SOURCE_FILE, SOURCE_ADDR, SOURCE_ADDR_INPLACE, SOURCE_WEB, SOURCE_MMAP} source_type;
+#endif
 
 typedef struct {
 	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
@@ -39,6 +47,10 @@ typedef struct {
 	size_t cols; // amount of cols, declared in tssb header. Should be used by library user
 	size_t sizestorage; // how much bytes we need for storing value of binary sizes. Can be used by user to determine which macro from GETU**SSB family can be used
 	char *source; // pointer to memory area for filename and, later, to memory are with tssb. Must not be used by user
+	char *tablemem; // pointer to memory area for pointer table, if it's placed apart from source (e.g. mapped file). Must not be used by user
+	size_t resolved_rows; // amount of rows which were already resolved by parsing. Must not be used by user
+	size_t resolved_pos; // position of newline sigil of first unresolved row. Must not be used by user
+	unsigned flags; // how source and tablemem were obtained, so release_tssb() knows what to do with them. Must not be used by user
 } tssb;
 
 tssb check_tssb(const char *filename);
@@ -52,12 +64,235 @@ tssb prepare_tssb(const char *filename, void *stackmem, size_t msize);
 //     How much memory will be used from stackmem? Here is its: 8 + u.size + u.rows * sizeof(void *) + (u.cols + 1) * u.rows * sizeof(void *). You also can use TSSB_CALCULATE macros for that.
 //     You also must pass msize if you used stackmem because we going to recheck if we will fit.
 
+tssb prepare_tssb_mmap(const char *filename, void *stackmem, size_t msize);
+// above
+// Just like prepare_tssb(), but instead of reading whole file to private memory, file is mapped read-only and shared,
+// so every process which maps same file uses same pages. Only space for pointer table is going to be allocated.
+// Pass non-NULL value to stackmem if you already have memory space for pointer table.
+//     How much memory will be used from stackmem? Use TSSB_CALCULATE_MMAP macros for that, and pass it as msize.
+//     If stackmem is NULL, pointer table will be allocated by parse_tssb().
+// Cells are pointing straight into mapping, so they are valid until release_tssb() call.
+// On big endian platforms sizes are swapped in place during parsing, so mapping is private there.
+
+tssb check_tssb_addr(const void *source, size_t size);
+// above
+// Just like check_tssb(), but TSSB object of _size_ bytes is located in memory at _source_ address.
+
+tssb prepare_tssb_addr(source_type t, const void *source, size_t size, void *stackmem, size_t msize);
+// above
+// Evaluates requered preparations before parsing of TSSB object of _size_ bytes, which is located in memory at
+// _source_ address, e.g. embedded into binary or received through IPC. No file I/O is involved, so that's the
+// way to use libtssb without POSIX. Depending on source_type:
+// If SOURCE_ADDR:         Copy object to freshly allocated memory, just like prepare_tssb() does with file.
+//                         If _stackmem_ has passed, place it there instead of allocation (see TSSB_CALCULATE)
+// If SOURCE_ADDR_INPLACE: Use object right where it is, with no copy. Only space for pointer table is needed:
+//                         pass it as _stackmem_ (see TSSB_CALCULATE_MMAP), or it will be allocated by parse_tssb().
+//                         Source memory must stay valid until you're done with cells. On big endian platforms
+//                         sizes are swapped in place during parsing, so source must be writable there.
+// Other source types are not supported.
+
+void release_tssb(tssb *u);
+// above
+// Frees (or unmaps) everything that was allocated (or mapped) by prepare_tssb*() and parse_tssb() calls.
+// Memory that you were passed as stackmem stays untouched.
+
 char ***parse_tssb(tssb *p);
 // above
-// Returns twodimensional array with pointers memory objects.
+// Returns twodimensional array with pointers memory objects. NULL is returned if any cell is going beyond the object.
 // When you are done with this data and you were not passed non-NULL pointer as an stackmem argument from
 // previous prepare_tssb() call, use free() on this pointer.
 
+bool parse_tssb_lazy(tssb *p);
+// above
+// Alternative for parse_tssb(), which is useful for huge tables, when only few rows are used. It does nothing
+// except preparations, and rows are resolved later by tssb_row() only when they are required. Rows that are
+// located after the last requested one are never touched.
+// Returns false if something went wrong.
+
+char **tssb_row(tssb *p, size_t row);
+// above
+// Returns array of pointers to cells of choosen row (terminated with NULL, just like rows of parse_tssb() result),
+// resolving it first if needed. Works after both parse_tssb() and parse_tssb_lazy().
+// Returns NULL if row is out of table, or if parsing failed (then errreasonstr is set).
+// After parse_tssb_lazy() rows must be accessed only through this function, because twodimensional array is
+// being filled on demand. tssb_row() modifies tssb object, so don't call it from several threads simultaneously.
+
+uint32_t *index_tssb32(tssb *p, void *stackmem, size_t msize);
+// above
+// Alternative for parse_tssb(), which builds compact index instead of twodimensional array with pointers.
+// Index contains rows * cols 32 bit offsets of cells from the beginning of tssb object, row after row, without any
+// NULL terminators. That's about half of memory for pointers on 64 bit platforms, and no pointer chasing.
+// Unlike twodimensional array of pointers, compact index is not limited by max_acceptable_dimension_size, so it can
+// be used with prepare_tssb_mmap() for tables with millions of rows. Object itself must fit in 4GB though.
+// Pass non-NULL value to stackmem if you already have memory space for index. Use TSSB_CALCULATE_INDEX32 macros
+// to retrieve how much memory is required and pass it as msize. Otherwise, index is allocated, so use free() on it.
+// Cells that are absent in tssb object have 0 offset. Use TSSB_CELL32 to retrieve cell itself.
+
+#define TSSB_CELL32(structure, index, row, col) ((structure).source + (index)[(size_t) (row) * (structure).cols + (col)])
+// above
+// Retrieve pointer to cell from compact index. Use getssbsize() or GETU**SSB macroses for its size, as usual.
+
+typedef struct {
+	uint32_t row;
+	uint32_t col;
+} tssb_cell_ref;
+
+typedef struct {
+	const char *data; // NULL if cell is absent
+	size_t size;
+} tssb_cell_view;
+
+#define TSSB_GATHER_DISTANCE 8 // how many cells ahead gather_tssb*() family prefetches size fields of cells
+
+size_t gather_tssb(tssb *p, const tssb_cell_ref *refs, size_t amount, tssb_cell_view *out);
+// above
+// Fetches _amount_ cells at once: pointer and size of cell refs[i] is placed to out[i], so a whole response can be
+// assembled from one array. Works after parse_tssb() and parse_tssb_lazy() (unresolved rows are resolved, just like
+// tssb_row() does). Slots of table and size fields of cells of resolved rows are prefetched ahead of use, so cache
+// misses of different cells are overlapped, which is much faster than fetching them one by one when table is bigger
+// than cache. Absent cells and cells out of table are {NULL, 0}. Returns sum of sizes, or SIZE_MAX if any of refs is
+// out of table, or its row is absent in data or can't be parsed (then errreasonstr is set). Other entries are filled
+// anyway.
+
+size_t gather_tssb32(tssb *p, const uint32_t *index, const tssb_cell_ref *refs, size_t amount, tssb_cell_view *out);
+// above
+// Just like gather_tssb(), but cells are fetched from compact index. That's index_tssb32() result, or s.index
+// of tssb_shared object: gather_tssb32(&s.u, s.index, refs, amount, out).
+
+struct iovec;
+
+size_t gather_tssb_iovec(tssb *p, const tssb_cell_ref *refs, size_t amount, struct iovec *iov);
+size_t gather_tssb32_iovec(tssb *p, const uint32_t *index, const tssb_cell_ref *refs, size_t amount, struct iovec *iov);
+// above
+// Same as above, but result is placed to iov array, so it can be passed to single writev() call right away.
+// Absent cells are empty elements, writev() skips them. POSIX only.
+
+typedef struct {
+	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
+	tssb u; // source points into shared segment. Don't parse it, use it with index, TSSB_CELL32() and getssbsize()
+	const uint32_t *index; // compact index, just like one that index_tssb32() builds
+	void *segment; // Must not be used by user
+	size_t segment_size; // Must not be used by user
+	unsigned flags; // Must not be used by user
+} tssb_shared;
+
+bool share_tssb(tssb *p, int fd);
+// above
+// Builds compact index for prepared TSSB object and writes position independent layout (header, object itself and
+// index) to _fd_, which is supposed to be memfd_create() or shm_open() descriptor (or file on tmpfs). After that any
+// process which has that descriptor (e.g. prefork workers, or with SCM_RIGHTS) can use attach_tssb_shared(), so
+// table is parsed once and stored in memory once, no matter how many processes are using it.
+
+tssb_shared attach_tssb_shared(int fd);
+// above
+// Maps layout written by share_tssb() read-only and shared. No parsing is involved, cells are available right away:
+// TSSB_CELL32(s.u, s.index, row, col). Layout must be produced on platform with same byte order.
+
+tssb_shared prepare_tssb_indexed(const char *filename);
+// above
+// Opens pre-indexed TSSB file (SSBTRANSLATI0NS_I signature, see TSSB_BUILD_INDEXED) with read-only shared mapping.
+// Offset table is stored in file, so there is no parsing: only offsets are checked to point inside table.
+// Cells are available right away with TSSB_CELL32(s.u, s.index, row, col), just like with attach_tssb_shared().
+// Pooled files (SSBTRANSLATI0NS_P signature, see TSSB_BUILD_POOLED) are opened the same way, but their pool is
+// walked once to check that every distinct cell fits in file. Identical cells are sharing the same pointer there.
+// Regular TSSB files are accepted too, but they are indexed with index_tssb32() during opening.
+
+tssb_shared prepare_tssb_indexed_addr(void *source, size_t size);
+// above
+// Just like prepare_tssb_indexed(), but object of _size_ bytes is located in memory at _source_, which must stay
+// valid until detach_tssb_shared() call. On big endian platforms sizes and offsets are swapped in place, so source
+// must be writable there. Unlike functions above, it's available on non-POSIX platforms too.
+
+void detach_tssb_shared(tssb_shared *s);
+// above
+// Releases everything obtained by attach_tssb_shared(), prepare_tssb_indexed() or prepare_tssb_indexed_addr().
+
+typedef struct {
+	uint32_t *buckets; // row number + 1 in every bucket, 0 means empty bucket
+	size_t size; // amount of buckets, power of two
+	size_t col; // which column is the key
+} tssb_hash;
+
+size_t check_tssb_hash(const tssb *u);
+// above
+// Retrieve amount of bytes that you'll need for stackmem memory for hash_tssb()
+
+tssb_hash hash_tssb(tssb *p, size_t col, void *stackmem, size_t msize);
+// above
+// Builds hash table which maps bytes of _col_ cell to number of row, so that row can be found by find_tssb_row()
+// in O(1), e.g. by message id. Must be called after parse_tssb() or parse_tssb_lazy() (every row will be resolved).
+// If several rows have same key, first one wins.
+// Pass non-NULL value to stackmem if you already have memory space, and msize which is equal to check_tssb_hash().
+// Otherwise buckets are allocated, so use free() on buckets member when you're done.
+// If something went wrong, buckets member is NULL and errreasonstr is set.
+
+#define TSSB_NO_ROW SIZE_MAX
+
+size_t find_tssb_row(tssb *p, const tssb_hash *h, const void *key, size_t size);
+// above
+// Returns number of row which has _key_ of _size_ bytes in hashed column, or TSSB_NO_ROW.
+
+typedef bool (*tssb_cell_callback)(void *ctx, size_t row, size_t col, const char *data, size_t size);
+// above
+// Callback for stream_tssb(), which is called for every cell. _data_ is valid only during the call.
+// Return false to stop streaming.
+
+tssb stream_tssb(int fd, size_t chunk, tssb_cell_callback callback, void *ctx);
+// above
+// Walks TSSB object once, reading it from _fd_ by pieces of _chunk_ bytes, so it works with pipes, sockets and
+// files which are larger than memory. Sizes and cells which are crossing chunk boundaries are handled, and peak
+// memory usage is bounded by chunk size plus the largest cell. Nothing is allocated after return.
+// Returned tssb object has only informational members filled (rows, cols, sizestorage, and size is amount of
+// consumed bytes). If errreasonstr is not NULL, something went wrong.
+
+#define TSSB_BUILD_INDEXED 0x1 // emit pre-indexed variant: offset table of every cell, then regular tssb object
+#define TSSB_BUILD_POOLED 0x2 // emit pooled variant: offset table of every cell, then every distinct cell only once
+
+typedef struct {
+	const char *errreasonstr; // if something BAD happens, here will be pointer to null terminated string with appropriate error reason
+	unsigned options; // TSSB_BUILD_* flags. Set them before build_tssb() or write_tssb()
+	size_t rows; // amount of rows which were added
+	size_t cols; // the biggest amount of cells in a row
+	size_t cells; // amount of cells which were added
+	size_t largest; // size of the largest cell, which determines sizestorage of result
+	size_t current_cols; // amount of cells in last row. Must not be used by user
+	char *arena; // every added row and cell in order of addition. Must not be used by user
+	size_t arena_size; // Must not be used by user
+	size_t arena_capacity; // Must not be used by user
+} tssb_builder;
+// above
+// Collects cells for TSSB object, which can be emitted later with build_tssb() or write_tssb().
+// Zeroed tssb_builder is ready for use.
+
+bool add_tssb_row(tssb_builder *b);
+// above
+// Starts new row. Must be called before the first cell too.
+
+bool add_tssb_cell(tssb_builder *b, const void *data, size_t size);
+// above
+// Copies cell to the end of current row.
+
+size_t calculate_tssb_build(tssb_builder *b);
+// above
+// Returns exact amount of bytes of TSSB object, or 0 if builder is empty or something went wrong.
+// The narrowest signature (SSBTRANSLATI0NS_0 ... SSBTRANSLATI0NS_3) that fits the largest cell is used.
+
+size_t build_tssb(tssb_builder *b, void *buffer, size_t size);
+// above
+// Emits TSSB object to _buffer_ in one pass. Returns amount of written bytes, or 0 if buffer is not enough.
+// Result can be passed to prepare_tssb_addr() right away.
+// With TSSB_BUILD_POOLED identical cells are interned, so every distinct payload is stored once and offset table
+// refers to it as many times as needed. That's a hash table over arena during both calculate_tssb_build() and
+// build_tssb(). Pooled object must fit in 4GB, and it's opened with prepare_tssb_indexed() instead.
+
+bool write_tssb(tssb_builder *b, int fd);
+// above
+// Emits TSSB object to memory, then writes it to _fd_ with single write() (unless it's interrupted or partial).
+
+void release_tssb_builder(tssb_builder *b);
+// above
+// Frees everything and zeroes builder, so it can be used again.
+
 size_t getssbsize(void *cell, tssb u, size_t *var);
 // above
 // Moves to size_t variable amount of bytes which are stored in choosen cell.
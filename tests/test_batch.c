@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libssb_batch.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+const char directory[] = "testdata_batch";
+const char essb_binary[108] = "SSBTEMPLATE0\x09\x00\x00\x00\x34\x00\x00\x00\x46irst text1sttagSCNDSABCD EFGBEBRASKOTINYAKI_TAKI!z\n\x0A\x00\x00\x00\xFA\xFF\xFF\xFF\x04\x00\x00\x00\xFF\xFF\xFF\xFF\xF8\xFF\xFF\xFF\x05\x00\x00\x00\xF0\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01\x00\x00\x00";
+#define TSSB_FILES 24
+
+#define TESTT(operand, operator, operand2) if(!(operand operator operand2)) do {printf("Condition: %s Evaluated %ld Expected: %ld\n", #operand " " #operator " " #operand2, (long) operand, (long) operand2); retval = false;} while(0)
+#define TESTTSTR(tested_str, expected) if (memcmp(tested_str, expected, strizeof(expected)) != 0) do{printf("Condition: %s Expected %s\n", #tested_str , expected); retval = false;} while(0)
+
+static bool write_file(const char *name, const void *data, size_t size) {
+	char path[64];
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return false;
+	ssize_t got = write(fd, data, size);
+	close(fd);
+	return got == (ssize_t) size;
+}
+
+static bool prepare_directory(void) {
+	// above
+	// tssb_NN.ssb files have their number in the only cell, essb_N.ssb are regular templates, zz_garbage is neither.
+
+	if (mkdir(directory, 0700) < 0 and errno != EEXIST) return false;
+	for (int i = 0; i < TSSB_FILES; i++) {
+		char name[32], cell[8];
+		snprintf(name, sizeof(name), "tssb_%02d.ssb", i);
+		snprintf(cell, sizeof(cell), "%02d", i);
+		tssb_builder b = {0};
+		add_tssb_row(&b);
+		add_tssb_cell(&b, cell, 2);
+		char built[64];
+		size_t size = build_tssb(&b, built, sizeof(built));
+		release_tssb_builder(&b);
+		if (size == 0 or write_file(name, built, size) == false) return false;
+	}
+	return write_file("essb_0.ssb", essb_binary, sizeof(essb_binary)) and
+		write_file("essb_1.ssb", essb_binary, sizeof(essb_binary)) and write_file("zz_garbage", "garbage", 7);
+}
+
+static void remove_directory(void) {
+	char path[64];
+	for (int i = 0; i < TSSB_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/tssb_%02d.ssb", directory, i);
+		unlink(path);
+	}
+	const char * const others[] = {"essb_0.ssb", "essb_1.ssb", "zz_garbage"};
+	for (size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+		snprintf(path, sizeof(path), "%s/%s", directory, others[i]);
+		unlink(path);
+	}
+	rmdir(directory);
+}
+
+static bool directory_check(size_t threads) {
+	bool retval = true;
+	ssb_batch b = load_ssb_directory(directory, threads);
+	if (b.errreasonstr != NULL) return printf("%s\n", b.errreasonstr), false;
+	TESTT(b.amount, ==, TSSB_FILES + 3);
+	if (b.amount != TSSB_FILES + 3) return release_ssb_batch(&b), false;
+
+	for (size_t i = 0; i < 2; i++) {
+		TESTT(b.files[i].errreasonstr, ==, NULL);
+		TESTT(b.files[i].is_essb, ==, true);
+		TESTT(b.files[i].e.records_amount, ==, 9);
+	}
+	for (int i = 0; i < TSSB_FILES; i++) {
+		ssb_loaded *f = b.files + 2 + i;
+		char cell[8];
+		snprintf(cell, sizeof(cell), "%02d", i);
+		TESTT(f->errreasonstr, ==, NULL);
+		TESTT(f->is_essb, ==, false);
+		if (f->table == NULL or memcmp(f->table[0][0], cell, 2) != 0) retval = false;
+	}
+	TESTT(b.files[TSSB_FILES + 2].errreasonstr, ==, err_not_a_valid_essb);
+	release_ssb_batch(&b);
+	TESTT(b.files, ==, NULL);
+	return retval;
+}
+
+static bool list_check(void) {
+	bool retval = true;
+	const char * const filenames[] = {"testdata_batch/essb_1.ssb", "testdata_batch/absent.ssb", "testdata_batch/tssb_07.ssb"};
+	ssb_batch b = load_ssb_batch(filenames, 3, 0);
+	if (b.errreasonstr != NULL) return printf("%s\n", b.errreasonstr), false;
+	TESTT(b.files[0].errreasonstr, ==, NULL);
+	TESTT(b.files[0].is_essb, ==, true);
+	TESTT(b.files[1].errreasonstr, !=, NULL);
+	TESTT(b.files[2].errreasonstr, ==, NULL);
+	if (b.files[2].table == NULL) retval = false; else TESTTSTR(b.files[2].table[0][0], "07");
+	release_ssb_batch(&b);
+
+	b = load_ssb_batch(filenames, 0, 1);
+	TESTT(b.errreasonstr, ==, err_invalid_arg);
+	return retval;
+}
+
+#define TEST(a, foo) do {printf("Test: %s. Result: %s\n", a, (foo) ? "passed" : (retval = EXIT_FAILURE, "failed"));} while(0)
+
+int main(int argc, char **argv) {
+	int retval = EXIT_SUCCESS;
+
+	if (prepare_directory() == false) {
+		printf("Can't prepare directory for testing batch loading. Reason: %s\n", strerror(errno));
+		remove_directory();
+		return EXIT_FAILURE;
+	}
+
+	TEST("load_ssb_directory with one thread", directory_check(1));
+	TEST("load_ssb_directory with 4 threads", directory_check(4));
+	TEST("load_ssb_directory with thread per CPU", directory_check(0));
+	TEST("load_ssb_batch", list_check());
+
+	remove_directory();
+	return retval;
+}
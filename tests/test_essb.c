@@ -60,8 +60,284 @@ static bool consistency_check(essb *e) {
 	return retval;
 }
 
+static bool keys_check(essb *e) {
+	bool retval = true;
+	if (index_essb_keys(e, NULL) == false) return printf("%s\n", e->errreasonstr), false;
+	TESTT(e->keys_amount, ==, 5);
+	TESTT(e->keys[0].record, ==, 1); TESTT(e->keys[0].span_seek, ==,  0); TESTT(e->keys[0].span_size, ==, 10);
+	TESTT(e->keys[1].record, ==, 3); TESTT(e->keys[1].span_seek, ==, 16); TESTT(e->keys[1].span_size, ==,  4);
+	TESTT(e->keys[2].record, ==, 4); TESTT(e->keys[2].span_seek, ==, 21); TESTT(e->keys[2].span_size, ==,  0);
+	TESTT(e->keys[3].record, ==, 6); TESTT(e->keys[3].span_seek, ==, 29); TESTT(e->keys[3].span_size, ==,  5);
+	TESTT(e->keys[4].record, ==, 7); TESTT(e->keys[4].span_seek, ==, 50); TESTT(e->keys[4].span_size, ==,  0);
+	TESTT(ESSB_TAIL_SEEK(*e), ==, 51);
+	TESTT(check_essb_keys(e), ==, 5 * sizeof(essb_key));
+	return retval;
+}
+
+static bool resolver(void *ctx, const essb *e, uint32_t key, const void **data, size_t *size) {
+	const char * const substitutions[] = {"one", "", "four", "six", "seven"};
+	if (key >= sizeof(substitutions) / sizeof(substitutions[0])) return false;
+	*data = substitutions[key];
+	*size = strlen(substitutions[key]);
+	return true;
+}
+
+static bool empty_resolver(void *ctx, const essb *e, uint32_t key, const void **data, size_t *size) {
+	*data = "";
+	*size = 0;
+	return true;
+}
+
+static bool hash_check(essb *e) {
+	bool retval = true;
+	if (hash_essb_keys(e, NULL) == false) return printf("%s\n", e->errreasonstr), false;
+	TESTT(find_essb_key(e, "1sttag", 6), ==, 0);
+	TESTT(find_essb_key(e, "S", 1), ==, 1);
+	TESTT(find_essb_key(e, "ABCD EFG", 8), ==, 2);
+	TESTT(find_essb_key(e, "SKOTINYAKI_TAKI!", 16), ==, 3);
+	TESTT(find_essb_key(e, "z", 1), ==, 4);
+	TESTT(ESSB_NEXT_KEY(*e, 4), ==, ESSB_NO_KEY);
+	TESTT(find_essb_key(e, "SCND", 4), ==, ESSB_NO_KEY); // static record
+	TESTT(find_essb_key(e, "1sttagg", 7), ==, ESSB_NO_KEY);
+
+	const char duplicates[] = "SSBTEMPLATE0\x03\x00\x00\x00\x03\x00\x00\x00" "aba" "\x00\xFF\xFF\xFF\xFF\x01\x00\x00\x00\xFF\xFF\xFF\xFF";
+	essb d = {0};
+	if (parse_essb(&d, SOURCE_ADDR, duplicates, NULL) == false) return printf("%s\n", d.errreasonstr), false;
+	index_essb_keys(&d, NULL);
+	TESTT(check_essb_hash(&d), ==, (4 + 2) * sizeof(uint32_t));
+	uint32_t stackmem[check_essb_hash(&d) / sizeof(uint32_t)]; // hash table is an array of uint32_t
+	if (hash_essb_keys(&d, stackmem) == false) {
+		release_essb(&d);
+		return printf("Can't hash keys\n"), false;
+	}
+	uint32_t first = find_essb_key(&d, "a", 1);
+	TESTT(first, ==, 0);
+	TESTT(ESSB_NEXT_KEY(d, first), ==, 1);
+	TESTT(ESSB_NEXT_KEY(d, 1), ==, ESSB_NO_KEY);
+	TESTT(find_essb_key(&d, "b", 1), ==, ESSB_NO_KEY);
+	release_essb(&d);
+	return retval;
+}
+
+static bool render_check(essb *e) {
+	bool retval = true;
+	const char expected[] = "First textoneSCNDfourBEBRAsixseven\n";
+
+	struct iovec iov[2 * 5 + 1]; // ESSB_CALCULATE_IOVEC() is not available before keys index is built
+	size_t used = render_essb_iovec(e, resolver, NULL, iov, sizeof(iov) / sizeof(iov[0]));
+	TESTT(used, ==, 8);
+	char joined[sizeof(expected)], *fly = joined;
+	for (size_t i = 0; i < used; i++) {
+		if (fly + iov[i].iov_len > joined + sizeof(joined)) return printf("Rendering result is too long\n"), false;
+		memcpy(fly, iov[i].iov_base, iov[i].iov_len);
+		fly += iov[i].iov_len;
+	}
+	TESTT((fly - joined), ==, strizeof(expected));
+	TESTTSTR(joined, expected);
+	TESTT(render_essb_iovec(e, resolver, NULL, iov, 7), ==, SIZE_MAX);
+
+	const char lonely[] = "SSBTEMPLATE0\x01\x00\x00\x00\x01\x00\x00\x00" "a" "\x00\x00\x00\xFF\xFF\xFF\xFF"; // single key
+	essb k = {0};
+	if (parse_essb(&k, SOURCE_ADDR, lonely, NULL) == false) return printf("%s\n", k.errreasonstr), false;
+	TESTT(render_essb_iovec(&k, empty_resolver, NULL, iov, 1), ==, 0); // empty result is not an error
+	TESTT(k.errreasonstr, ==, NULL);
+	release_essb(&k);
+
+	size_t size = render_essb_size(e, resolver, NULL);
+	TESTT(size, ==, strizeof(expected));
+	char buffer[strizeof(expected)];
+	TESTT(render_essb_buffer(e, resolver, NULL, buffer, sizeof(buffer)), ==, strizeof(expected));
+	TESTTSTR(buffer, expected);
+	TESTT(render_essb_buffer(e, resolver, NULL, buffer, sizeof(buffer) - 1), ==, SIZE_MAX);
+	return retval;
+}
+
+static bool prefix_sum_kernel_check(uint32_t (*kernel)(const int32_t *, int32_t *, size_t)) {
+	// above
+	// Compare kernel with scalar version on every length up to 100 and one long array with ragged tail
+
+	bool retval = true;
+	enum {maxlen = 4099};
+	static int32_t src[maxlen], expected[maxlen], got[maxlen];
+	srand(42);
+	for (unsigned i = 0; i < maxlen; i++) src[i] = (rand() % 2001 - 1000) * (rand() % 1000);
+	src[0] = INT32_MIN; // wraps around in every implementation
+
+	for (size_t len = 0; len <= 100; len++) {
+		uint32_t t1 = abs_prefix_sum_scalar_priv_ssb(src + 1, expected, len);
+		uint32_t t2 = kernel(src + 1, got, len);
+		if (t1 != t2 or memcmp(expected, got, len * sizeof(int32_t)) != 0) {
+			printf("Prefix sum mismatch, length %zu\n", len);
+			retval = false;
+		}
+	}
+	if (abs_prefix_sum_scalar_priv_ssb(src, expected, maxlen) != kernel(src, got, maxlen) or
+		memcmp(expected, got, sizeof(got)) != 0) {
+		printf("Prefix sum mismatch, whole array\n");
+		retval = false;
+	}
+	return retval;
+}
+
+static bool substring_kernel_check(const char *(*kernel)(const char *, const char *, const char *, size_t)) {
+	// above
+	// Compare kernel with naive search on delimiter-heavy text, for every length up to 100 (which is making every
+	// ragged tail), then on the whole text.
+
+	bool retval = true;
+	enum {maxlen = 4099};
+	static char text[maxlen + 1];
+	srand(42);
+	for (unsigned i = 0; i <= maxlen; i++) text[i] = "{{{}a"[rand() % 5];
+	const char *needles[] = {"{", "{{", "{}", "{{}", "{a}}", "{{a{}", "}}}}}}}}"}; // the last one is rare
+	for (size_t n = 0; n < sizeof(needles) / sizeof(needles[0]); n++) {
+		size_t size = strlen(needles[n]);
+		for (size_t len = 0; len <= maxlen; len = len == 100 ? maxlen : len + 1) {
+			const char *expected = NULL, *from = text + 1; // unaligned
+			for (size_t i = 0; i + size <= len and expected == NULL; i++) if (memcmp(from + i, needles[n], size) == 0) expected = from + i;
+			if (kernel(from, from + len, needles[n], size) != expected) {
+				printf("Substring search mismatch, needle \"%s\", length %zu\n", needles[n], len);
+				retval = false;
+			}
+		}
+	}
+	return retval;
+}
+
+static bool malformed_check(unsigned first, const int32_t *sizes, unsigned amount) {
+	// above
+	// Replaces _amount_ sizes of test binary starting from _first_ one. parse_essb() must refuse result.
+
+	bool retval = true;
+	char corrupted[sizeof(binary)];
+	memcpy(corrupted, binary, sizeof(binary));
+	memcpy(corrupted + sizeof(binary) - 9 * sizeof(int32_t) + first * sizeof(int32_t), sizes, amount * sizeof(int32_t));
+	essb e = {.records = NULL};
+	TESTT(parse_essb(&e, SOURCE_ADDR, corrupted, NULL), ==, false);
+	TESTT(e.errreasonstr, ==, err_not_a_valid_essb);
+	TESTT(e.records, ==, NULL);
+	release_essb(&e);
+	return retval;
+}
+
+static bool bswap_kernel_check(void (*kernel)(void *, const void *, size_t)) {
+	// above
+	// Compare kernel with scalar version on every length up to 40 and on unaligned data, both copying and in place
+
+	bool retval = true;
+	enum {maxlen = 40};
+	uint32_t source[maxlen + 1], expected[maxlen + 1], got[maxlen + 1], copied[maxlen + 1];
+	for (size_t len = 0; len <= maxlen; len++) {
+		for (unsigned i = 0; i <= maxlen; i++) source[i] = expected[i] = got[i] = copied[i] = 0x01020304u * (i + 1);
+		bswap32_bulk_scalar_priv_ssb((char *) expected + 1, (char *) expected + 1, len);
+		kernel((char *) got + 1, (char *) got + 1, len);
+		kernel((char *) copied + 1, (char *) source + 1, len);
+		if (memcmp(expected, got, sizeof(got)) != 0 or memcmp(expected, copied, sizeof(copied)) != 0) {
+			printf("Byte swap mismatch, length %zu\n", len);
+			retval = false;
+		}
+	}
+	uint32_t v = 0x01020304u;
+	bswap32_bulk_scalar_priv_ssb(&v, &v, 1);
+	TESTT(v, ==, 0x04030201u);
+	return retval;
+}
+
+static void make_foreign(char *foreign) {
+	// above
+	// Test binary as if it was produced on platform with other byte order
+
+	memcpy(foreign, binary, sizeof(binary));
+	bswap32_bulk_scalar_priv_ssb(foreign + strizeof(essb_signature_0), foreign + strizeof(essb_signature_0), 2);
+	bswap32_bulk_scalar_priv_ssb(foreign + sizeof(binary) - 9 * sizeof(int32_t), foreign + sizeof(binary) - 9 * sizeof(int32_t), 9);
+}
+
+static bool foreign_check(const char *foreign_filename) {
+	bool retval = true;
+	char foreign[sizeof(binary)] __attribute__((aligned(4)));
+	make_foreign(foreign);
+	essb e = {.records = NULL};
+
+	TESTT(check_essb(SOURCE_ADDR, foreign), ==, check_essb(SOURCE_ADDR, binary));
+	if (parse_essb(&e, SOURCE_ADDR, foreign, NULL) == false) return printf("%s\n", e.errreasonstr), false;
+	if (consistency_check(&e) == false) retval = false;
+	release_essb(&e);
+
+	TESTT(check_essb(SOURCE_ADDR_INPLACE, foreign), ==, sizeof(foreign) + 9 * sizeof(int32_t));
+	char *inplace = malloc(check_essb(SOURCE_ADDR_INPLACE, foreign)); // exactly as much as required
+	if (inplace == NULL) return false;
+	memcpy(inplace, foreign, sizeof(foreign));
+	if (parse_essb(&e, SOURCE_ADDR_INPLACE, inplace, inplace) == false) return printf("%s\n", e.errreasonstr), free(inplace), false;
+	if (consistency_check(&e) == false) retval = false;
+	release_essb(&e);
+	TESTT(memcmp(inplace, binary, sizeof(binary)), ==, 0); // converted to native layout, so it can be parsed again
+	if (parse_essb(&e, SOURCE_ADDR_INPLACE, inplace, inplace) == false or consistency_check(&e) == false) retval = false;
+	release_essb(&e);
+	free(inplace);
+
+	FILE *f = fopen(foreign_filename, "wb");
+	if (f == NULL or fwrite(foreign, 1, sizeof(foreign), f) != sizeof(foreign) or fclose(f) != 0) return false;
+	TESTT(check_essb(SOURCE_FILE, foreign_filename), ==, check_essb(SOURCE_ADDR, binary));
+	if (parse_essb(&e, SOURCE_FILE, foreign_filename, NULL) == false or consistency_check(&e) == false) retval = false;
+	release_essb(&e);
+	if (parse_essb(&e, SOURCE_MMAP, foreign_filename, NULL) == false or consistency_check(&e) == false) retval = false;
+	release_essb(&e);
+	int32_t seek[18]; // sizes are swapped right after seek table
+	TESTT(check_essb(SOURCE_MMAP, foreign_filename), ==, sizeof(seek));
+	if (parse_essb(&e, SOURCE_MMAP, foreign_filename, seek) == false or consistency_check(&e) == false) retval = false;
+	TESTT(e.record_size, ==, seek + 9);
+	release_essb(&e);
+
+	char reread[sizeof(binary)]; // mapping is read-only, so file itself stays foreign
+	f = fopen(foreign_filename, "rb");
+	if (f == NULL or fread(reread, 1, sizeof(reread), f) != sizeof(reread) or fclose(f) != 0) return false;
+	TESTT(memcmp(reread, foreign, sizeof(foreign)), ==, 0);
+	return retval;
+}
+
+static bool either_order_check(uint32_t amount, uint32_t total, bool foreign) {
+	// above
+	// Counters which are making sense in both byte orders, but only one layout is valid. Size of object is unknown
+	// for SOURCE_ADDR, so byte order must be chosen by sizes. Every record is equally sized, the last one takes the
+	// rest, and signs are alternating.
+
+	bool retval = true;
+	size_t layout = sizeof(struct essb_format) + total + (4 - total % 4) % 4 + amount * sizeof(int32_t);
+	uint32_t *object = malloc(layout + amount * sizeof(int32_t)); // in place parsing places record_seek after sizes, and
+	// that's exactly what check_essb(SOURCE_ADDR_INPLACE) must return
+	if (object == NULL) return false;
+	struct essb_format *format = (void *) object;
+	memcpy(format->signature, essb_signature_0, strizeof(essb_signature_0));
+	format->records_amount = amount;
+	format->records_total_size = total;
+	memset(format->records, 'a', total);
+	int32_t *sizes = (void *) (format->records + total + (4 - total % 4) % 4);
+	for (uint32_t i = 0; i < amount; i++) sizes[i] = (i % 2 ? 1 : -1) * (int32_t) (i < amount - 1 ? total / amount : total - total / amount * i);
+	int32_t last = sizes[amount - 1];
+	if (foreign) {
+		bswap32_bulk_priv_ssb(&format->records_amount, &format->records_amount, 2);
+		bswap32_bulk_priv_ssb(sizes, sizes, amount);
+	}
+
+	essb e = {.records = NULL};
+	TESTT(check_essb(SOURCE_ADDR, object), ==, layout - sizeof(struct essb_format) + amount * sizeof(int32_t));
+	TESTT(check_essb(SOURCE_ADDR_INPLACE, object), ==, layout + amount * sizeof(int32_t));
+	if (parse_essb(&e, SOURCE_ADDR, object, NULL) == false) retval = false;
+	TESTT(e.records_amount, ==, amount);
+	TESTT(e.record_seek[amount - 1], ==, (int32_t) (total - abs(last)));
+	TESTT(e.record_size[amount - 1], ==, last);
+	release_essb(&e);
+	if (parse_essb(&e, SOURCE_ADDR_INPLACE, object, object) == false) retval = false;
+	TESTT(e.records_total_size, ==, total);
+	TESTT(e.record_size[amount - 1], ==, last);
+	release_essb(&e);
+	free(object);
+	return retval;
+}
+
+const char filename[] = "testdata_essb.ssb";
+
 static bool prepare_file_and_essb(essb *e) {
-	char filename[] = "testdata_essb.ssb";
 	int fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
 	if (fd < 0) {
 		printf("Can't create file for testing essb. Reason: %s\n", strerror(errno));
@@ -88,15 +364,40 @@ static bool prepare_file_and_essb(essb *e) {
 		unlink(filename);
 		return false;
 	}
-	unlink(filename);
 
 	return true;
 }
 
+static bool compile_check(const char *text, const char *open, const char *close) {
+	// above
+	// Template must be compiled to exactly same bytes as test binary has, on little endian platforms at least.
+
+	bool retval = true;
+	essb e = {0};
+	size_t required = check_essb_template(text, strlen(text), open, close);
+	TESTT(required, ==, sizeof(binary) + 9 * sizeof(int32_t));
+	int32_t buffer[(sizeof(binary) + 9 * sizeof(int32_t)) / sizeof(int32_t)];
+	if (compile_essb(&e, text, strlen(text), open, close, buffer, sizeof(buffer) - 1) == true) retval = false;
+	TESTT(e.errreasonstr, ==, err_no_space);
+	e.errreasonstr = NULL;
+	if (compile_essb(&e, text, strlen(text), open, close, buffer, sizeof(buffer)) == false) return printf("%s\n", e.errreasonstr), false;
+	if (consistency_check(&e) == false) retval = false;
+	if (IS_BIG_ENDIAN == false and memcmp(buffer, binary, sizeof(binary)) != 0) retval = false;
+	release_essb(&e);
+
+	TESTT(check_essb_template("a{{b", 4, "{{", "}}"), ==, 0);
+	TESTT(check_essb_template("a{{}}b", 6, "{{", "}}"), ==, 0);
+	TESTT(check_essb_template("", 0, "{{", "}}"), ==, 0);
+	if (compile_essb(&e, "a{{b", 4, "{{", "}}", buffer, sizeof(buffer)) == true) retval = false;
+	TESTT(e.errreasonstr, ==, err_template_fail);
+	return retval;
+}
+
 #define TEST(a, foo) do {printf("Test: %s. Result: %s\n", a, (foo) ? "passed" : (retval = EXIT_FAILURE, "failed"));} while(0)
 
 int main(int argc, char **argv) {
-	essb e[4] = {};
+	essb e[6] = {0};
+	char *temp2 = NULL; // in place parsed e[3] lives there
 
 	int retval = EXIT_SUCCESS;
 
@@ -104,23 +405,72 @@ int main(int argc, char **argv) {
 	TEST("1", consistency_check(e + 0));
 
 	if (parse_essb(e + 1, SOURCE_ADDR, binary, NULL) == false) {printf("%s\n", e[1].errreasonstr); retval = EXIT_FAILURE; goto exit;}
-	TEST("2", consistency_check(e + 0));
+	TEST("2", consistency_check(e + 1));
 
 	if (check_essb(SOURCE_ADDR, binary) == 0) {printf("Failed to check_essb(SOURCE_ADDR, binary)\n"); retval = EXIT_FAILURE; goto exit;}
 	char *temp = malloc(check_essb(SOURCE_ADDR, binary));
 	if (parse_essb(e + 2, SOURCE_ADDR, binary, temp) == false) {printf("%s\n", e[2].errreasonstr); free(temp); retval = EXIT_FAILURE; goto exit;}
-	TEST("3", consistency_check(e + 0));
+	TEST("3", consistency_check(e + 2));
 	free(temp);
 
-	char temp2[350];
+	temp2 = malloc(check_essb(SOURCE_ADDR_INPLACE, binary)); // exactly as much as required, header included
+	if (temp2 == NULL) {retval = EXIT_FAILURE; goto exit;}
 	memcpy(temp2, binary, sizeof(binary));
-	if (parse_essb(e + 3, SOURCE_ADDR_INPLACE, temp2, temp2) == false) {printf("%s\n", e[2].errreasonstr); retval = EXIT_FAILURE; goto exit;}
-	TEST("3", consistency_check(e + 0));
+	if (parse_essb(e + 3, SOURCE_ADDR_INPLACE, temp2, temp2) == false) {printf("%s\n", e[3].errreasonstr); retval = EXIT_FAILURE; goto exit;}
+	TEST("4", consistency_check(e + 3));
+
+	if (parse_essb(e + 4, SOURCE_MMAP, filename, NULL) == false) {printf("%s\n", e[4].errreasonstr); retval = EXIT_FAILURE; goto exit;}
+	TEST("5", consistency_check(e + 4));
+
+	if (check_essb(SOURCE_MMAP, filename) != 9 * sizeof(int32_t)) {printf("Failed to check_essb(SOURCE_MMAP, filename)\n"); retval = EXIT_FAILURE; goto exit;}
+	int32_t seek[9];
+	if (parse_essb(e + 5, SOURCE_MMAP, filename, seek) == false) {printf("%s\n", e[5].errreasonstr); retval = EXIT_FAILURE; goto exit;}
+	TEST("6", consistency_check(e + 5));
+
+	TEST("keys", keys_check(e + 4));
+	TEST("render", render_check(e + 4));
+	TEST("render without keys index", render_check(e + 5));
+	TEST("hash", hash_check(e + 4));
+
+	TEST("compile", compile_check("First text{{1sttag}}SCND{{S}}{{ABCD EFG}}BEBRA{{SKOTINYAKI_TAKI!}}{{z}}\n", "{{", "}}"));
+	TEST("compile with custom delimiters", compile_check("First text<%1sttag%>SCND<%S%><%ABCD EFG%>BEBRA<%SKOTINYAKI_TAKI!%><%z%>\n", "<%", "%>"));
+	TEST("compile with one byte delimiters", compile_check("First text$1sttag$SCND$S$$ABCD EFG$BEBRA$SKOTINYAKI_TAKI!$$z$\n", "$", "$"));
+
+	TEST("sizes which don't sum up", malformed_check(8, (const int32_t []) {2}, 1));
+	TEST("sizes which sum up after wrapping", malformed_check(0, (const int32_t []) {INT32_MIN, INT32_MIN + 100, 120}, 3));
+	char huge[sizeof(binary)];
+	memcpy(huge, binary, sizeof(binary));
+	memcpy(huge + strizeof(essb_signature_0), &(const uint32_t) {UINT32_MAX / 8}, sizeof(uint32_t));
+	TEST("layout which doesn't fit in uint32_t", check_essb(SOURCE_ADDR, huge) == 0);
+	memcpy(huge + strizeof(essb_signature_0), (const uint32_t []) {3, 0x800000F0u}, sizeof(uint32_t) * 2);
+	TEST("records which don't fit in int32_t", check_essb(SOURCE_ADDR, huge) == 0);
+
+	TEST("foreign byte order", foreign_check("testdata_essb_foreign.ssb"));
+	TEST("native header which is making sense in both byte orders", either_order_check(256, 0x100000, false));
+	TEST("foreign header which is making sense in both byte orders", either_order_check(0x10000, 0x1000, true));
+	unlink("testdata_essb_foreign.ssb");
+	TEST("byte swap, dispatched", bswap_kernel_check(bswap32_bulk_priv_ssb));
+#if defined(SSB_X86_SIMD)
+	if (__builtin_cpu_supports("ssse3")) TEST("byte swap, ssse3", bswap_kernel_check(bswap32_bulk_ssse3_priv_ssb));
+	if (__builtin_cpu_supports("avx2")) TEST("byte swap, avx2", bswap_kernel_check(bswap32_bulk_avx2_priv_ssb));
+#endif
+
+	TEST("prefix sum, dispatched", prefix_sum_kernel_check(abs_prefix_sum_priv_ssb));
+#if defined(SSB_X86_SIMD)
+	if (__builtin_cpu_supports("sse2")) TEST("prefix sum, sse2", prefix_sum_kernel_check(abs_prefix_sum_sse2_priv_ssb));
+	if (__builtin_cpu_supports("avx2")) TEST("prefix sum, avx2", prefix_sum_kernel_check(abs_prefix_sum_avx2_priv_ssb));
+#endif
+
+	TEST("substring search, scalar", substring_kernel_check(find_substring_scalar_priv_ssb));
+	TEST("substring search, dispatched", substring_kernel_check(find_substring_priv_ssb));
+#if defined(SSB_X86_SIMD)
+	if (__builtin_cpu_supports("sse2")) TEST("substring search, sse2", substring_kernel_check(find_substring_sse2_priv_ssb));
+	if (__builtin_cpu_supports("avx2")) TEST("substring search, avx2", substring_kernel_check(find_substring_avx2_priv_ssb));
+#endif
 
 	exit:
-	free(e[0].records);
-	free(e[1].records);
-	// ITS STACK! DON'T free(e[2].records);
-	// ITS STACK! DON'T free(e[3].records);
+	unlink(filename);
+	for (unsigned i = 0; i < sizeof(e) / sizeof(e[0]); i++) release_essb(e + i); // stackmem stays untouched
+	free(temp2);
 	return retval;
 }
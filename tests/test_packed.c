@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libssb_packed.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+const char filename[] = "testdata_packed.ssb";
+#define ROWS 1000
+#define COLS 4
+#define ROWS_PER_BLOCK 16
+
+#define TESTT(operand, operator, operand2) if(!(operand operator operand2)) do {printf("Condition: %s Evaluated %ld Expected: %ld\n", #operand " " #operator " " #operand2, (long) operand, (long) operand2); retval = false;} while(0)
+
+static size_t make_cell(char *cell, size_t row, size_t col) {
+	// above
+	// Translation-like table: untranslated fallback, empty cell, message id, and absent last cell in every 3rd row
+
+	switch (col) {
+	case 0: return sprintf(cell, "message_%zu", row);
+	case 1: return sprintf(cell, "Untranslated fallback string, which is repeated in many rows");
+	case 2: return 0;
+	default: return sprintf(cell, "Translation of message number %zu", row * 7919 % 1000);
+	}
+}
+
+static char *build_original(size_t *size) {
+	tssb_builder b = {0};
+	char cell[128];
+	for (size_t row = 0; row < ROWS; row++) {
+		add_tssb_row(&b);
+		for (size_t col = 0; col < (row % 3 ? COLS : COLS - 1); col++) add_tssb_cell(&b, cell, make_cell(cell, row, col));
+	}
+	*size = calculate_tssb_build(&b);
+	char *object = malloc(*size);
+	if (object != NULL and build_tssb(&b, object, *size) != *size) *size = 0;
+	release_tssb_builder(&b);
+	return object;
+}
+
+static bool same_row(tssb_packed *p, size_t row) {
+	bool retval = true;
+	char **r = tssb_packed_row(p, row);
+	if (r == NULL) return printf("Row %zu: %s\n", row, p->errreasonstr), false;
+	char expected[128];
+	size_t col = 0, size;
+	for (; r[col] != NULL; col++) {
+		TESTT(getssbsize(r[col], p->u, &size), ==, make_cell(expected, row, col));
+		if (memcmp(r[col], expected, size) != 0) retval = false;
+	}
+	TESTT(col, ==, (row % 3 ? COLS : COLS - 1));
+	return retval;
+}
+
+static bool codec_check(void) {
+	// above
+	// Every length up to 600 of incompressible data, runs (overlapping matches) and mixed data.
+
+	bool retval = true;
+	uint8_t source[600], packed[LZ_BOUND(sizeof(source))], raw[sizeof(source)];
+	uint64_t state = 88172645463325252ull;
+	for (size_t i = 0; i < sizeof(source); i++) {
+		state ^= state << 13, state ^= state >> 7, state ^= state << 17;
+		source[i] = i < 200 ? (uint8_t) state : i < 400 ? 'a' : "abc"[state % 3];
+	}
+	for (size_t offset = 0; offset < sizeof(source); offset += 200) for (size_t length = 0; length <= sizeof(source) - offset; length++) {
+		size_t got = lz_compress(source + offset, length, packed, sizeof(packed));
+		if (got == 0 or lz_decompress(packed, got, raw, length) == false or memcmp(raw, source + offset, length) != 0) {
+			printf("Codec mismatch, offset %zu, length %zu\n", offset, length);
+			return false;
+		}
+		if (length > 0) TESTT(lz_decompress(packed, got, raw, length - 1), ==, false); // wrong size is detected
+	}
+	TESTT(lz_compress(source + 200, 200, packed, sizeof(packed)), <, 20); // run of same byte
+	return retval;
+}
+
+static bool packed_check(void) {
+	bool retval = true;
+	size_t size;
+	char *original = build_original(&size);
+	if (original == NULL or size == 0) return free(original), false;
+	tssb u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, original, size, NULL, 0);
+	size_t bound = calculate_tssb_pack(&u, ROWS_PER_BLOCK);
+	char *packed = malloc(bound);
+	size_t packed_size = packed ? pack_tssb(&u, ROWS_PER_BLOCK, packed, bound) : 0;
+	if (packed_size == 0) return printf("%s\n", u.errreasonstr), free(packed), free(original), false;
+	TESTT(packed_size * 3, <, size);
+	TESTT(pack_tssb(&u, ROWS_PER_BLOCK, packed, packed_size), ==, 0); // buffer must be as big as bound
+	release_tssb(&u);
+
+	tssb_packed p = prepare_tssb_packed_addr(packed, packed_size, 4);
+	if (p.errreasonstr != NULL) return printf("%s\n", p.errreasonstr), free(packed), free(original), false;
+	TESTT(p.u.rows, ==, ROWS);
+	TESTT(p.u.cols, ==, COLS);
+	TESTT(p.blocks, ==, (ROWS + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK);
+	for (size_t row = 0; row < ROWS; row++) if (same_row(&p, row) == false) retval = false;
+	TESTT(p.misses, ==, p.blocks); // sequential walk decompresses every block once
+	TESTT(tssb_packed_row(&p, ROWS), ==, NULL);
+
+	// least recently used block is evicted, and rows of the rest stay valid
+	release_tssb_packed(&p);
+	p = prepare_tssb_packed_addr(packed, packed_size, 4);
+	char **held = tssb_packed_row(&p, 5);
+	tssb_packed_row(&p, ROWS_PER_BLOCK);
+	tssb_packed_row(&p, ROWS_PER_BLOCK * 2);
+	tssb_packed_row(&p, ROWS_PER_BLOCK * 3);
+	TESTT(p.misses, ==, 4);
+	if (held == NULL or memcmp(held[0], "message_5", 9) != 0) retval = false;
+	tssb_packed_row(&p, 0);
+	tssb_packed_row(&p, ROWS_PER_BLOCK * 4); // evicts block 1
+	TESTT(p.misses, ==, 5);
+	if (same_row(&p, 7) == false) retval = false;
+	TESTT(p.misses, ==, 5);
+	if (same_row(&p, ROWS_PER_BLOCK + 1) == false) retval = false;
+	TESTT(p.misses, ==, 6);
+	release_tssb_packed(&p);
+	TESTT(p.slots, ==, NULL);
+
+	// malformed objects
+	p = prepare_tssb_packed_addr(packed, packed_size - 1, 4);
+	TESTT(p.errreasonstr, ==, err_not_a_valid_tssb);
+	p = prepare_tssb_packed_addr(original, size, 4);
+	TESTT(p.errreasonstr, ==, err_not_a_valid_tssb);
+	char *entry = packed + TSSB_PACKED_HEADER + TSSB_PACKED_ENTRY;
+	put_le(entry + 12, get_le(entry + 12, sizeof(uint32_t)) + 1, sizeof(uint32_t)); // block 1 claims more raw bytes
+	p = prepare_tssb_packed_addr(packed, packed_size, 4);
+	TESTT(p.errreasonstr, ==, NULL);
+	TESTT(tssb_packed_row(&p, ROWS_PER_BLOCK), ==, NULL);
+	TESTT(p.errreasonstr, ==, err_parse_fail);
+	if (same_row(&p, 0) == false) retval = false; // other blocks are fine
+	release_tssb_packed(&p);
+
+	free(packed);
+	free(original);
+	return retval;
+}
+
+static bool file_check(void) {
+	bool retval = true;
+	size_t size;
+	char *original = build_original(&size);
+	if (original == NULL or size == 0) return free(original), false;
+	tssb u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, original, size, NULL, 0);
+	int fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0 or write_tssb_packed(&u, 0, fd) == false) retval = false;
+	if (fd >= 0) close(fd);
+	release_tssb(&u);
+	free(original);
+
+	tssb_packed p = prepare_tssb_packed(filename, 0);
+	if (p.errreasonstr != NULL) return printf("%s\n", p.errreasonstr), false;
+	TESTT(p.rows_per_block, ==, TSSB_PACKED_ROWS);
+	for (size_t i = 0; i < ROWS; i += 37) if (same_row(&p, ROWS - 1 - i) == false) retval = false; // backwards
+	TESTT(p.misses, <=, p.blocks);
+	release_tssb_packed(&p);
+
+	p = prepare_tssb_packed("absent file", 0);
+	TESTT(p.errreasonstr, !=, NULL);
+	return retval;
+}
+
+#define TEST(a, foo) do {printf("Test: %s. Result: %s\n", a, (foo) ? "passed" : (retval = EXIT_FAILURE, "failed"));} while(0)
+
+int main(int argc, char **argv) {
+	int retval = EXIT_SUCCESS;
+
+	TEST("LZ codec round trip", codec_check());
+	TEST("pack_tssb and tssb_packed_row", packed_check());
+	TEST("write_tssb_packed and prepare_tssb_packed", file_check());
+
+	unlink(filename);
+	return retval;
+}
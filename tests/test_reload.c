@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libssb_reload.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+
+const char filename[] = "testdata_reload.ssb";
+const char tempname[] = "testdata_reload.ssb.tmp";
+const char essb_binary[108] = "SSBTEMPLATE0\x09\x00\x00\x00\x34\x00\x00\x00\x46irst text1sttagSCNDSABCD EFGBEBRASKOTINYAKI_TAKI!z\n\x0A\x00\x00\x00\xFA\xFF\xFF\xFF\x04\x00\x00\x00\xFF\xFF\xFF\xFF\xF8\xFF\xFF\xFF\x05\x00\x00\x00\xF0\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01\x00\x00\x00";
+
+#define TESTT(operand, operator, operand2) if(!(operand operator operand2)) do {printf("Condition: %s Evaluated %ld Expected: %ld\n", #operand " " #operator " " #operand2, (long) operand, (long) operand2); retval = false;} while(0)
+#define TESTTSTR(tested_str, expected) if (memcmp(tested_str, expected, strizeof(expected)) != 0) do{printf("Condition: %s Expected %s\n", #tested_str , expected); retval = false;} while(0)
+
+static bool write_table(const char *name, const char *cell) {
+	// above
+	// Writes 1x1 table to temporary file, then replaces _name_ with it, just like deployment does.
+
+	tssb_builder b = {0};
+	add_tssb_row(&b);
+	add_tssb_cell(&b, cell, strlen(cell));
+	int fd = open(tempname, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	bool written = fd >= 0 and write_tssb(&b, fd);
+	if (fd >= 0) close(fd);
+	release_tssb_builder(&b);
+	return written and rename(tempname, name) == 0;
+}
+
+static void sleep_ms(long ms) {
+	struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = ms % 1000 * 1000000};
+	nanosleep(&ts, NULL);
+}
+
+static uint64_t wait_version(ssb_reload *r, size_t slot, uint64_t version) {
+	// above
+	// inotify is asynchronous, so wait a bit until watcher publishes expected version.
+
+	uint64_t got = 0;
+	for (int i = 0; i < 500 and got < version; i++) {
+		got = enter_ssb_reload(r, slot)->version;
+		leave_ssb_reload(r, slot);
+		if (got < version) sleep_ms(10);
+	}
+	return got;
+}
+
+static bool stop_readers;
+
+static void *reader_thread(void *arg) {
+	// above
+	// Hammers enter/leave during reloads. Reading freed snapshot would be caught by valgrind or sanitizers.
+
+	ssb_reload *r = arg;
+	size_t slot = register_ssb_reader(r);
+	if (slot == SSB_NO_READER) return arg;
+	size_t sum = 0;
+	while (__atomic_load_n(&stop_readers, __ATOMIC_RELAXED) == false) {
+		const ssb_snapshot *s = enter_ssb_reload(r, slot);
+		sum += getssbsize(s->table[0][0], s->u, &(size_t){0}) + (unsigned char) s->table[0][0][0];
+		leave_ssb_reload(r, slot);
+	}
+	unregister_ssb_reader(r, slot);
+	return sum ? NULL : arg;
+}
+
+static bool tssb_reload_check(void) {
+	bool retval = true;
+	if (write_table(filename, "one") == false) return false;
+
+	ssb_reload r = {0};
+	if (start_ssb_reload(&r, filename, SSB_RELOAD_TSSB, 4) == false) return printf("%s\n", r.errreasonstr), false;
+	size_t slot = register_ssb_reader(&r);
+	size_t probe = register_ssb_reader(&r);
+	TESTT(slot, ==, 0);
+	TESTT(probe, ==, 1);
+
+	const ssb_snapshot *old = enter_ssb_reload(&r, slot);
+	TESTT(old->version, ==, 1);
+	TESTTSTR(old->table[0][0], "one");
+
+	if (write_table(filename, "two") == false) retval = false;
+	TESTT(wait_version(&r, probe, 2), ==, 2);
+	const ssb_snapshot *fresh = enter_ssb_reload(&r, probe);
+	TESTTSTR(fresh->table[0][0], "two");
+	leave_ssb_reload(&r, probe);
+	sleep_ms(5 * RELOAD_RECLAIM_INTERVAL);
+	TESTTSTR(old->table[0][0], "one"); // still entered, so it must not be freed
+	pthread_mutex_lock(&r.writer);
+	TESTT(r.retired, ==, old);
+	pthread_mutex_unlock(&r.writer);
+	leave_ssb_reload(&r, slot);
+
+	bool retired = true;
+	for (int i = 0; i < 500 and retired; i++) {
+		sleep_ms(10);
+		pthread_mutex_lock(&r.writer);
+		retired = r.retired != NULL;
+		pthread_mutex_unlock(&r.writer);
+	}
+	TESTT(retired, ==, false);
+
+	int fd = open(filename, O_WRONLY | O_TRUNC);
+	if (fd >= 0) close(fd);
+	TESTT(reload_ssb_now(&r), ==, false); // broken file doesn't replace working snapshot
+	TESTT(__atomic_load_n(&r.reload_error, __ATOMIC_RELAXED), !=, NULL);
+	TESTTSTR(enter_ssb_reload(&r, slot)->table[0][0], "two");
+	leave_ssb_reload(&r, slot);
+	unregister_ssb_reader(&r, slot);
+	unregister_ssb_reader(&r, probe);
+
+	pthread_t readers[3];
+	for (int i = 0; i < 3; i++) pthread_create(readers + i, NULL, reader_thread, &r);
+	for (int i = 0; i < 20; i++) {
+		if (write_table(filename, i % 2 ? "odd" : "even") == false) retval = false;
+		if (reload_ssb_now(&r) == false) retval = false;
+	}
+	__atomic_store_n(&stop_readers, true, __ATOMIC_RELAXED);
+	for (int i = 0; i < 3; i++) {
+		void *failed;
+		pthread_join(readers[i], &failed);
+		TESTT(failed, ==, NULL);
+	}
+	TESTT(enter_ssb_reload(&r, 0)->version, >=, 22);
+	leave_ssb_reload(&r, 0);
+
+	stop_ssb_reload(&r);
+	TESTT(r.current, ==, NULL);
+	return retval;
+}
+
+static bool essb_reload_check(void) {
+	bool retval = true;
+	int fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return false;
+	ssize_t got = write(fd, essb_binary, sizeof(essb_binary));
+	close(fd);
+	if (got != sizeof(essb_binary)) return false;
+
+	ssb_reload r = {0};
+	if (start_ssb_reload(&r, filename, SSB_RELOAD_ESSB, 1) == false) return printf("%s\n", r.errreasonstr), false;
+	size_t slot = register_ssb_reader(&r);
+	TESTT(register_ssb_reader(&r), ==, SSB_NO_READER);
+	const ssb_snapshot *s = enter_ssb_reload(&r, slot);
+	TESTT(s->e.records_amount, ==, 9);
+	TESTT(find_essb_key(&s->e, "SKOTINYAKI_TAKI!", 16), ==, 3);
+	leave_ssb_reload(&r, slot);
+	stop_ssb_reload(&r);
+
+	TESTT(start_ssb_reload(&r, "testdata_reload_absent.ssb", SSB_RELOAD_ESSB, 1), ==, false);
+	TESTT(r.errreasonstr, !=, NULL);
+	return retval;
+}
+
+#define TEST(a, foo) do {printf("Test: %s. Result: %s\n", a, (foo) ? "passed" : (retval = EXIT_FAILURE, "failed"));} while(0)
+
+int main(int argc, char **argv) {
+	int retval = EXIT_SUCCESS;
+
+	TEST("tssb reload", tssb_reload_check());
+	TEST("essb reload", essb_reload_check());
+
+	unlink(filename);
+	unlink(tempname);
+	return retval;
+}
@@ -0,0 +1,669 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libtssb.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+const char binary[52] = "SSBTRANSLATI0NS_1\x02\x00\x00\x00\x02\x00\x00\x00\xFF\xFF\x05\x00" "hello" "\x05\x00" "world" "\xFF\xFF\x02\x00" "hi" "\x03\x00" "all";
+const char filename[] = "testdata_tssb.ssb";
+
+#define TESTT(operand, operator, operand2) if(!(operand operator operand2)) do {printf("Condition: %s Evaluated %ld Expected: %ld\n", #operand " " #operator " " #operand2, (long) operand, (long) operand2); retval = false;} while(0)
+#define TESTTSTR(tested_str, expected) if (memcmp(tested_str, expected, strizeof(expected)) != 0) do{printf("Condition: %s Expected %s\n", #tested_str , expected); retval = false;} while(0)
+
+static bool consistency_check(tssb *u, char ***t) {
+	bool retval = true;
+	size_t size;
+	if (t == NULL) {
+		printf("Error during parsing tssb: %s\n", u->errreasonstr);
+		return false;
+	}
+	TESTT(u->rows, ==, 2);
+	TESTT(u->cols, ==, 2);
+	TESTT(u->sizestorage, ==, sizeof(uint16_t));
+
+	TESTT(getssbsize(t[0][0], *u, &size), ==, 5); TESTTSTR(t[0][0], "hello");
+	TESTT(getssbsize(t[0][1], *u, &size), ==, 5); TESTTSTR(t[0][1], "world");
+	TESTT(getssbsize(t[1][0], *u, &size), ==, 2); TESTTSTR(t[1][0], "hi");
+	TESTT(getssbsize(t[1][1], *u, &size), ==, 3); TESTTSTR(t[1][1], "all");
+	TESTT(t[0][2], ==, NULL);
+	TESTT(t[1][2], ==, NULL);
+	return retval;
+}
+
+static bool prepare_file(void) {
+	int fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) {
+		printf("Can't create file for testing tssb. Reason: %s\n", strerror(errno));
+		return false;
+	}
+
+	ssize_t got = write(fd, binary, sizeof(binary));
+	close(fd);
+	if (got < (ssize_t) sizeof(binary)) {
+		printf("Write test data in file for testing tssb. Reason: %s\n", strerror(errno));
+		unlink(filename);
+		return false;
+	}
+
+	return true;
+}
+
+static bool lazy_check(tssb *u) {
+	bool retval = true;
+	if (parse_tssb_lazy(u) == false) {
+		printf("Error during parsing tssb: %s\n", u->errreasonstr);
+		return false;
+	}
+	TESTT(u->resolved_rows, ==, 0);
+	char **second = tssb_row(u, 1); // walks through first one
+	TESTT(u->resolved_rows, ==, 2);
+	char **first = tssb_row(u, 0);
+	TESTT(tssb_row(u, 2), ==, NULL);
+	if (first == NULL or second == NULL) return false;
+	TESTTSTR(first[0], "hello");
+	TESTTSTR(first[1], "world");
+	TESTTSTR(second[0], "hi");
+	TESTTSTR(second[1], "all");
+	TESTT(second[2], ==, NULL);
+	return retval;
+}
+
+static bool index32_check(tssb *u) {
+	bool retval = true;
+	size_t size;
+	uint32_t *index = index_tssb32(u, NULL, 0);
+	if (index == NULL) {
+		printf("Error during indexing tssb: %s\n", u->errreasonstr);
+		return false;
+	}
+	TESTT(getssbsize(TSSB_CELL32(*u, index, 0, 0), *u, &size), ==, 5); TESTTSTR(TSSB_CELL32(*u, index, 0, 0), "hello");
+	TESTT(getssbsize(TSSB_CELL32(*u, index, 0, 1), *u, &size), ==, 5); TESTTSTR(TSSB_CELL32(*u, index, 0, 1), "world");
+	TESTT(getssbsize(TSSB_CELL32(*u, index, 1, 0), *u, &size), ==, 2); TESTTSTR(TSSB_CELL32(*u, index, 1, 0), "hi");
+	TESTT(getssbsize(TSSB_CELL32(*u, index, 1, 1), *u, &size), ==, 3); TESTTSTR(TSSB_CELL32(*u, index, 1, 1), "all");
+	free(index);
+	return retval;
+}
+
+static bool hash_check(tssb *u) {
+	bool retval = true;
+	if (parse_tssb(u) == NULL) return printf("%s\n", u->errreasonstr), false;
+	tssb_hash h = hash_tssb(u, 0, NULL, 0);
+	if (h.buckets == NULL) return printf("%s\n", u->errreasonstr), false;
+	TESTT(find_tssb_row(u, &h, "hello", 5), ==, 0);
+	TESTT(find_tssb_row(u, &h, "hi", 2), ==, 1);
+	TESTT(find_tssb_row(u, &h, "world", 5), ==, TSSB_NO_ROW);
+	TESTT(find_tssb_row(u, &h, "hell", 4), ==, TSSB_NO_ROW);
+	free(h.buckets);
+
+	char stackmem[check_tssb_hash(u)];
+	h = hash_tssb(u, 1, stackmem, sizeof(stackmem));
+	if (h.buckets == NULL) return printf("%s\n", u->errreasonstr), false;
+	TESTT(find_tssb_row(u, &h, "all", 3), ==, 1);
+	TESTT(find_tssb_row(u, &h, "world", 5), ==, 0);
+	TESTT(hash_tssb(u, 2, NULL, 0).buckets, ==, NULL);
+	return retval;
+}
+
+static bool short_row_hash_check(void) {
+	// above
+	// Key cell is absent in short row, and table is parsed into caller's memory which is dirty. Such row can't be
+	// found, and hash_tssb() must not touch anything behind absent cell.
+
+	bool retval = true;
+	tssb_builder b = {0};
+	const char *keys[] = {"alpha", NULL, "gamma"};
+	for (unsigned row = 0; row < 3; row++) {
+		add_tssb_row(&b);
+		add_tssb_cell(&b, "value", 5);
+		if (keys[row] != NULL) add_tssb_cell(&b, keys[row], strlen(keys[row]));
+	}
+	size_t size = calculate_tssb_build(&b);
+	char object[size];
+	if (build_tssb(&b, object, size) != size) retval = false;
+	release_tssb_builder(&b);
+	if (retval == false) return false;
+
+	tssb u = check_tssb_addr(object, size);
+	char stackmem[TSSB_CALCULATE(u)];
+	memset(stackmem, 0xA5, sizeof(stackmem));
+	u = prepare_tssb_addr(SOURCE_ADDR, object, size, stackmem, sizeof(stackmem));
+	if (parse_tssb(&u) == NULL) return printf("%s\n", u.errreasonstr), false;
+	tssb_hash h = hash_tssb(&u, 1, NULL, 0);
+	if (h.buckets == NULL) return printf("%s\n", u.errreasonstr), release_tssb(&u), false;
+	TESTT(find_tssb_row(&u, &h, "alpha", 5), ==, 0);
+	TESTT(find_tssb_row(&u, &h, "gamma", 5), ==, 2);
+	TESTT(find_tssb_row(&u, &h, "", 0), ==, TSSB_NO_ROW);
+	free(h.buckets);
+	release_tssb(&u);
+	return retval;
+}
+
+static bool collect(void *ctx, size_t row, size_t col, const char *data, size_t size) {
+	char *fly = (char *) ctx + strlen(ctx);
+	fly += sprintf(fly, "%zu,%zu:", row, col);
+	memcpy(fly, data, size);
+	fly[size] = ';';
+	fly[size + 1] = '\0';
+	return true;
+}
+
+static bool stream_check(size_t chunk) {
+	bool retval = true;
+	int fds[2];
+	if (pipe(fds) < 0) return perror("pipe"), false;
+	write(fds[1], binary, sizeof(binary)); // fits in pipe buffer
+	close(fds[1]);
+	char collected[100] = "";
+	tssb u = stream_tssb(fds[0], chunk, collect, collected);
+	close(fds[0]);
+	if (u.errreasonstr != NULL) return printf("%s\n", u.errreasonstr), false;
+	TESTT(u.rows, ==, 2);
+	TESTT(u.cols, ==, 2);
+	TESTT(u.size, ==, sizeof(binary));
+	TESTTSTR(collected, "0,0:hello;0,1:world;1,0:hi;1,1:all;");
+
+	if (pipe(fds) < 0) return perror("pipe"), false;
+	write(fds[1], binary, sizeof(binary) - 1); // truncated
+	close(fds[1]);
+	u = stream_tssb(fds[0], chunk, collect, collected);
+	close(fds[0]);
+	TESTT(u.errreasonstr, ==, err_parse_fail);
+	return retval;
+}
+
+static bool shared_check(void) {
+	bool retval = true;
+	size_t size;
+	const char sharedname[] = "testdata_tssb_shared.ssb";
+	tssb u = prepare_tssb(filename, NULL, 0);
+	int fd = open(sharedname, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return release_tssb(&u), false;
+	if (share_tssb(&u, fd) == false) retval = false;
+	close(fd);
+	release_tssb(&u);
+
+	fd = open(sharedname, O_RDONLY);
+	tssb_shared s = attach_tssb_shared(fd);
+	close(fd); // mapping stays alive
+	unlink(sharedname);
+	if (s.errreasonstr != NULL) return printf("%s\n", s.errreasonstr), false;
+	TESTT(s.u.rows, ==, 2);
+	TESTT(s.u.cols, ==, 2);
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 0, 1), s.u, &size), ==, 5); TESTTSTR(TSSB_CELL32(s.u, s.index, 0, 1), "world");
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 1, 1), s.u, &size), ==, 3); TESTTSTR(TSSB_CELL32(s.u, s.index, 1, 1), "all");
+	detach_tssb_shared(&s);
+	TESTT(s.segment, ==, NULL);
+
+	fd = open(filename, O_RDONLY);
+	s = attach_tssb_shared(fd); // regular tssb file is not a shared layout
+	close(fd);
+	TESTT(s.errreasonstr, ==, err_not_a_valid_tssb);
+	return retval;
+}
+
+static bool indexed_check(void) {
+	bool retval = true;
+	size_t size;
+	const char indexedname[] = "testdata_tssb_indexed.ssb";
+	tssb_builder b = {.options = TSSB_BUILD_INDEXED};
+	add_tssb_row(&b);
+	add_tssb_cell(&b, "hello", 5);
+	add_tssb_cell(&b, "world", 5);
+	add_tssb_row(&b);
+	add_tssb_cell(&b, "hi", 2);
+	size_t indexed_size = calculate_tssb_build(&b);
+	char *object = malloc(indexed_size);
+	if (object == NULL or build_tssb(&b, object, indexed_size) != indexed_size) retval = false;
+	int fd = open(indexedname, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return release_tssb_builder(&b), free(object), false;
+	if (write_tssb(&b, fd) == false) retval = false;
+	close(fd);
+	release_tssb_builder(&b);
+
+	tssb u = prepare_tssb(indexedname, NULL, 0);
+	TESTT(u.errreasonstr, ==, err_not_a_valid_tssb); // it's not a regular tssb anymore
+	release_tssb(&u);
+
+	tssb_shared s = prepare_tssb_indexed(indexedname);
+	if (s.errreasonstr != NULL) return printf("%s\n", s.errreasonstr), unlink(indexedname), false;
+	TESTT(s.u.rows, ==, 2);
+	TESTT(s.u.cols, ==, 2);
+	TESTT(s.u.sizestorage, ==, sizeof(uint8_t));
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 0, 0), s.u, &size), ==, 5); TESTTSTR(TSSB_CELL32(s.u, s.index, 0, 0), "hello");
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 0, 1), s.u, &size), ==, 5); TESTTSTR(TSSB_CELL32(s.u, s.index, 0, 1), "world");
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 1, 0), s.u, &size), ==, 2); TESTTSTR(TSSB_CELL32(s.u, s.index, 1, 0), "hi");
+	TESTT(s.index[3], ==, 0);
+	detach_tssb_shared(&s);
+
+	fd = open(indexedname, O_WRONLY);
+	if (fd < 0 or lseek(fd, 28, SEEK_SET) != 28 or write(fd, "\xFF\xFF\x00\x00", 4) != 4) retval = false; // offset of first cell is out of table
+	if (fd >= 0) close(fd);
+	s = prepare_tssb_indexed(indexedname);
+	TESTT(s.errreasonstr, ==, err_not_a_valid_tssb);
+	unlink(indexedname);
+
+	if (object == NULL) return false;
+	s = prepare_tssb_indexed_addr(object, indexed_size);
+	TESTT(s.errreasonstr, ==, NULL);
+	detach_tssb_shared(&s);
+	uint32_t last = (uint32_t) (indexed_size - 28 - 4 * 4);
+	memcpy(object + 28, &last, sizeof(last)); // offset of first cell is inside object, but its size field is "i" of "hi"
+	s = prepare_tssb_indexed_addr(object, indexed_size);
+	TESTT(s.errreasonstr, ==, err_not_a_valid_tssb);
+	free(object);
+
+	s = prepare_tssb_indexed(filename); // regular one is indexed during opening
+	if (s.errreasonstr != NULL) return printf("%s\n", s.errreasonstr), false;
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 1, 1), s.u, &size), ==, 3); TESTTSTR(TSSB_CELL32(s.u, s.index, 1, 1), "all");
+	detach_tssb_shared(&s);
+	return retval;
+}
+
+static bool pooled_check(void) {
+	// above
+	// Fallback string is repeated in every row and empty cells are repeated too, so both are stored once.
+
+	bool retval = true;
+	size_t size;
+	const char pooledname[] = "testdata_tssb_pooled.ssb";
+	const char fallback[] = "Untranslated fallback string";
+	tssb_builder b = {.options = TSSB_BUILD_POOLED}, plain = {0};
+	for (unsigned row = 0; row < 3; row++) for (tssb_builder *t = &b; t != NULL; t = t == &b ? &plain : NULL) {
+		add_tssb_row(t);
+		add_tssb_cell(t, row == 1 ? "hi" : "hello", row == 1 ? 2 : 5);
+		add_tssb_cell(t, fallback, strizeof(fallback));
+		if (row < 2) add_tssb_cell(t, "", 0);
+	}
+	size_t pooled_size = calculate_tssb_build(&b), plain_size = calculate_tssb_build(&plain);
+	TESTT(pooled_size, ==, 28 + 3 * 3 * 4 + 1 + 5 + 1 + strizeof(fallback) + 1 + 1 + 2);
+	TESTT(plain_size, >, 3 * strizeof(fallback));
+	release_tssb_builder(&plain);
+	int fd = open(pooledname, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return release_tssb_builder(&b), false;
+	if (write_tssb(&b, fd) == false) retval = false;
+	close(fd);
+
+	tssb_shared s = prepare_tssb_indexed(pooledname);
+	if (s.errreasonstr != NULL) return printf("%s\n", s.errreasonstr), release_tssb_builder(&b), unlink(pooledname), false;
+	TESTT(s.u.rows, ==, 3);
+	TESTT(s.u.cols, ==, 3);
+	TESTT(s.u.size, ==, pooled_size);
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 0, 0), s.u, &size), ==, 5); TESTTSTR(TSSB_CELL32(s.u, s.index, 0, 0), "hello");
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 1, 0), s.u, &size), ==, 2); TESTTSTR(TSSB_CELL32(s.u, s.index, 1, 0), "hi");
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 2, 1), s.u, &size), ==, strizeof(fallback)); TESTTSTR(TSSB_CELL32(s.u, s.index, 2, 1), fallback);
+	TESTT(getssbsize(TSSB_CELL32(s.u, s.index, 1, 2), s.u, &size), ==, 0);
+	TESTT(s.index[0], ==, s.index[6]); // hello
+	TESTT(s.index[1], ==, s.index[4]); // fallback
+	TESTT(s.index[4], ==, s.index[7]);
+	TESTT(s.index[2], ==, s.index[5]); // empty cells
+	TESTT(s.index[8], ==, 0); // absent cell
+	detach_tssb_shared(&s);
+
+	// same object in memory, then malformed ones
+	char *object = malloc(pooled_size);
+	if (object == NULL or build_tssb(&b, object, pooled_size) != pooled_size) retval = false;
+	release_tssb_builder(&b);
+	s = prepare_tssb_indexed_addr(object, pooled_size);
+	TESTT(s.errreasonstr, ==, NULL);
+	TESTTSTR(TSSB_CELL32(s.u, s.index, 2, 0), "hello");
+	TESTT(s.segment, ==, NULL);
+	detach_tssb_shared(&s);
+	s = prepare_tssb_indexed_addr(object, pooled_size - 1); // last pool entry is truncated
+	TESTT(s.errreasonstr, ==, err_not_a_valid_tssb);
+	object[25] = 3; // width of size fields
+	s = prepare_tssb_indexed_addr(object, pooled_size);
+	TESTT(s.errreasonstr, ==, err_not_a_valid_tssb);
+	object[25] = 1;
+	memcpy(object + 28, "\x2A\x00\x00\x00", 4); // offset of first cell points into offset table
+	s = prepare_tssb_indexed_addr(object, pooled_size);
+	TESTT(s.errreasonstr, ==, err_not_a_valid_tssb);
+	TESTT(s.index, ==, NULL);
+	free(object);
+	unlink(pooledname);
+	return retval;
+}
+
+static bool gather_check(void) {
+	// above
+	// More refs than prefetch distance, in scattered order, with absent cells. Every kind of table and output must
+	// give same cells as tssb_row() does.
+
+	bool retval = true;
+	enum {rows = 40, cols = 3, amount = 5 * TSSB_GATHER_DISTANCE};
+	tssb_builder b = {0};
+	char cell[16];
+	for (unsigned row = 0; row < rows; row++) {
+		add_tssb_row(&b);
+		for (unsigned col = 0; col < (row % 5 ? cols : cols - 1); col++) add_tssb_cell(&b, cell, sprintf(cell, "r%uc%u", row, col));
+	}
+	size_t size = calculate_tssb_build(&b);
+	char *object = malloc(size), *lazy = malloc(size);
+	if (object == NULL or lazy == NULL or build_tssb(&b, object, size) != size) retval = false;
+	release_tssb_builder(&b);
+	if (retval == false) return free(object), free(lazy), false;
+	memcpy(lazy, object, size);
+
+	tssb_cell_ref refs[amount];
+	size_t expected = 0;
+	for (unsigned i = 0; i < amount; i++) {
+		refs[i] = (tssb_cell_ref) {.row = i * 7 % (rows - 1), .col = i % cols};
+		if (refs[i].row % 5 or refs[i].col < cols - 1) expected += sprintf(cell, "r%uc%u", refs[i].row, refs[i].col);
+	}
+	tssb u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, object, size, NULL, 0), l = prepare_tssb_addr(SOURCE_ADDR_INPLACE, lazy, size, NULL, 0);
+	uint32_t *index = parse_tssb(&u) != NULL ? index_tssb32(&u, NULL, 0) : NULL;
+	if (index == NULL or parse_tssb_lazy(&l) == false) retval = false;
+	tssb_cell_view views[3][amount];
+	struct iovec iov[2][amount];
+	if (retval) {
+		TESTT(gather_tssb(&u, refs, amount, views[0]), ==, expected);
+		TESTT(gather_tssb(&l, refs, amount, views[1]), ==, expected);
+		TESTT(gather_tssb32(&u, index, refs, amount, views[2]), ==, expected);
+		TESTT(gather_tssb_iovec(&u, refs, amount, iov[0]), ==, expected);
+		TESTT(gather_tssb32_iovec(&u, index, refs, amount, iov[1]), ==, expected);
+	}
+	for (unsigned i = 0; i < amount and retval; i++) {
+		char **r = tssb_row(&u, refs[i].row);
+		const char *data = refs[i].col < cols - 1 or refs[i].row % 5 ? r[refs[i].col] : NULL;
+		size_t length = data != NULL ? (size_t) sprintf(cell, "r%uc%u", refs[i].row, refs[i].col) : 0;
+		for (unsigned k = 0; k < 3; k++) {
+			const char *got = k == 1 and data != NULL ? u.source + (views[k][i].data - l.source) : views[k][i].data;
+			if (got != data or views[k][i].size != length) retval = false;
+		}
+		for (unsigned k = 0; k < 2; k++) if (iov[k][i].iov_base != data or iov[k][i].iov_len != length) retval = false;
+		if (data != NULL and memcmp(data, cell, length) != 0) retval = false;
+		if (retval == false) printf("Gather mismatch, ref %u\n", i);
+	}
+	TESTT(l.resolved_rows, ==, rows - 1); // the last row is never requested
+
+	// tables in caller's memory which is dirty, parsed eagerly and lazily: absent cells of short rows are {NULL, 0}
+	tssb c = check_tssb_addr(object, size);
+	size_t dirty_size = TSSB_CALCULATE(c), tablemem_size = TSSB_CALCULATE_MMAP(c);
+	char *dirty = malloc(dirty_size), *inplace = malloc(size);
+	for (unsigned k = 0; k < 2 and dirty != NULL and inplace != NULL and retval; k++) {
+		memset(dirty, 0xA5, dirty_size);
+		memcpy(inplace, object, size);
+		if (k == 0) c = prepare_tssb_addr(SOURCE_ADDR, object, size, dirty, dirty_size);
+		else c = prepare_tssb_addr(SOURCE_ADDR_INPLACE, inplace, size, dirty, tablemem_size);
+		if ((k == 0 ? parse_tssb(&c) != NULL : parse_tssb_lazy(&c)) == false) {
+			printf("%s\n", c.errreasonstr);
+			retval = false;
+			break;
+		}
+		TESTT(gather_tssb(&c, refs, amount, views[1]), ==, expected);
+		for (unsigned i = 0; i < amount; i++) {
+			if ((views[1][i].data == NULL) != (views[0][i].data == NULL) or views[1][i].size != views[0][i].size) retval = false;
+		}
+		if (retval == false) printf("Gather mismatch with dirty %s table\n", k == 0 ? "eager" : "lazy");
+		release_tssb(&c);
+	}
+	if (dirty == NULL or inplace == NULL) retval = false;
+	free(dirty);
+	free(inplace);
+
+	refs[amount - 1].row = rows;
+	TESTT(gather_tssb(&u, refs, amount, views[0]), ==, SIZE_MAX);
+	TESTT(views[0][amount - 1].data, ==, NULL);
+	TESTT(views[0][0].size, ==, 4);
+	refs[amount - 1] = (tssb_cell_ref) {.row = 0, .col = cols};
+	TESTT(gather_tssb32(&u, index, refs, amount, views[2]), ==, SIZE_MAX);
+	TESTT(gather_tssb(&u, refs, 0, views[0]), ==, 0);
+
+	// the last row overruns truncated object, and is parsed only when gather reaches it
+	release_tssb(&l);
+	l = prepare_tssb_addr(SOURCE_ADDR_INPLACE, lazy, size - 1, NULL, 0);
+	if (parse_tssb_lazy(&l) == false) retval = false;
+	refs[amount - 1] = (tssb_cell_ref) {.row = rows - 1, .col = 0};
+	TESTT(gather_tssb(&l, refs, amount, views[1]), ==, SIZE_MAX);
+	TESTT(l.errreasonstr, ==, err_parse_fail);
+	TESTT(views[1][0].size, ==, 4);
+
+	free(index);
+	release_tssb(&u);
+	release_tssb(&l);
+	free(object);
+	free(lazy);
+	return retval;
+}
+
+static bool huge_index32_check(void) {
+	// above
+	// Table which is far beyond max_acceptable_dimension_size. Every cell contains 4 byte little endian row number.
+
+	bool retval = true;
+	const uint32_t rows = 100000, cols = 3;
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL) return false;
+	fwrite("SSBTRANSLATI0NS_0", 1, strizeof("SSBTRANSLATI0NS_0"), f);
+	fwrite(&rows, sizeof(rows), 1, f);
+	fwrite(&cols, sizeof(cols), 1, f);
+	for (uint32_t row = 0; row < rows; row++) {
+		fputc(UCHAR_MAX, f);
+		for (uint32_t col = 0; col < cols; col++) {
+			fputc(sizeof(row), f);
+			fwrite(&row, sizeof(row), 1, f);
+		}
+	}
+	fclose(f);
+
+	tssb u = prepare_tssb_mmap(filename, NULL, 0);
+	if (u.errreasonstr != NULL) return printf("%s\n", u.errreasonstr), false;
+	TESTT(u.rows, ==, rows);
+	uint32_t *index = index_tssb32(&u, NULL, 0);
+	if (index == NULL) return printf("%s\n", u.errreasonstr), release_tssb(&u), false;
+	for (uint32_t row = 0; row < rows; row += 777) {
+		uint32_t got;
+		memcpy(&got, TSSB_CELL32(u, index, row, 2), sizeof(got));
+		TESTT(got, ==, row);
+		TESTT(GETU08SSB(TSSB_CELL32(u, index, row, 2)), ==, sizeof(got));
+	}
+	free(index);
+	TESTT(parse_tssb(&u), ==, NULL); // twodimensional array is still limited
+	release_tssb(&u);
+	return retval;
+}
+
+static bool builder_check(size_t wide, size_t width) {
+	// above
+	// Builds table with one cell of _wide_ size, which determines size field of result. Also has empty row and empty cell.
+
+	bool retval = true;
+	size_t size;
+	char *filler = malloc(wide);
+	if (filler == NULL) return false;
+	memset(filler, 'x', wide);
+
+	tssb_builder b = {0};
+	add_tssb_row(&b);
+	add_tssb_cell(&b, "hello", 5);
+	add_tssb_cell(&b, "world", 5);
+	add_tssb_row(&b);
+	add_tssb_cell(&b, "hi", 2);
+	add_tssb_cell(&b, "all", 3);
+	add_tssb_cell(&b, filler, wide);
+	add_tssb_row(&b);
+	add_tssb_row(&b);
+	add_tssb_cell(&b, "", 0);
+	size_t total = calculate_tssb_build(&b);
+	if (total == 0) return printf("%s\n", b.errreasonstr), free(filler), release_tssb_builder(&b), false;
+	TESTT(total, ==, strizeof("SSBTRANSLATI0NS_0") + 8 + 4 * width + 6 * width + 15 + wide);
+
+	char *built = malloc(total);
+	TESTT(build_tssb(&b, built, total - 1), ==, 0);
+	b.errreasonstr = NULL;
+	TESTT(build_tssb(&b, built, total), ==, total);
+
+	tssb u = prepare_tssb_addr(SOURCE_ADDR, built, total, NULL, 0);
+	char ***t = parse_tssb(&u);
+	if (t == NULL) {
+		printf("Error during parsing built tssb: %s\n", u.errreasonstr);
+		retval = false;
+	} else {
+		TESTT(u.rows, ==, 4);
+		TESTT(u.cols, ==, 3);
+		TESTT(u.sizestorage, ==, width);
+		TESTT(getssbsize(t[0][0], u, &size), ==, 5); TESTTSTR(t[0][0], "hello");
+		TESTT(getssbsize(t[0][1], u, &size), ==, 5); TESTTSTR(t[0][1], "world");
+		TESTT(t[0][2], ==, NULL);
+		TESTT(getssbsize(t[1][1], u, &size), ==, 3); TESTTSTR(t[1][1], "all");
+		TESTT(getssbsize(t[1][2], u, &size), ==, wide);
+		if (memcmp(t[1][2], filler, wide) != 0) retval = false;
+		TESTT(t[2][0], ==, NULL);
+		TESTT(getssbsize(t[3][0], u, &size), ==, 0);
+	}
+	release_tssb(&u);
+
+	int fd = open(filename, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0 or write_tssb(&b, fd) == false) retval = false;
+	if (fd >= 0) close(fd);
+	u = prepare_tssb(filename, NULL, 0);
+	if (parse_tssb(&u) == NULL or u.size != total) retval = false;
+	release_tssb(&u);
+
+	release_tssb_builder(&b);
+	TESTT(b.arena, ==, NULL);
+	TESTT(calculate_tssb_build(&b), ==, 0);
+	TESTT(b.errreasonstr, ==, err_empty_builder);
+	free(built);
+	free(filler);
+	return retval;
+}
+
+static bool malformed_check(size_t size, size_t at, uint16_t bsize) {
+	// above
+	// Cuts test binary to _size_ bytes, and if _at_ isn't zero, puts _bsize_ there. Every parser must refuse result.
+	// Copy is allocated with exact size, so sanitizers and valgrind are catching any read beyond it.
+
+	bool retval = true;
+	char *copy = malloc(size);
+	if (copy == NULL) return false;
+	for (unsigned parser = 0; parser < 3; parser++) {
+		memcpy(copy, binary, size); // big endian platforms are swapping sizes in place
+		if (at != 0) {
+			copy[at] = (char) (bsize & UCHAR_MAX);
+			copy[at + 1] = (char) (bsize >> CHAR_BIT);
+		}
+		tssb u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, copy, size, NULL, 0);
+		if (u.errreasonstr != NULL) retval = false;
+		bool accepted;
+		if (parser == 0) accepted = parse_tssb(&u) != NULL;
+		else if (parser == 1) accepted = parse_tssb_lazy(&u) and tssb_row(&u, 1) != NULL;
+		else accepted = index_tssb32(&u, NULL, 0) != NULL;
+		TESTT(accepted, ==, false);
+		TESTT(u.errreasonstr, ==, err_parse_fail);
+		release_tssb(&u);
+	}
+	free(copy);
+	return retval;
+}
+
+#define TEST(a, foo) do {printf("Test: %s. Result: %s\n", a, (foo) ? "passed" : (retval = EXIT_FAILURE, "failed"));} while(0)
+
+int main(int argc, char **argv) {
+	int retval = EXIT_SUCCESS;
+
+	if (prepare_file() == false) return EXIT_FAILURE;
+
+	tssb u = prepare_tssb(filename, NULL, 0);
+	TEST("prepare_tssb", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	u = check_tssb(filename);
+	char buffer[TSSB_CALCULATE(u)];
+	u = prepare_tssb(filename, buffer, sizeof(buffer));
+	TEST("prepare_tssb with stackmem", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	u = prepare_tssb_mmap(filename, NULL, 0);
+	TEST("prepare_tssb_mmap", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	u = check_tssb(filename);
+	char tablemem[TSSB_CALCULATE_MMAP(u)];
+	u = prepare_tssb_mmap(filename, tablemem, sizeof(tablemem));
+	TEST("prepare_tssb_mmap with stackmem", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	u = prepare_tssb_mmap(filename, NULL, 0);
+	TEST("parse_tssb_lazy", lazy_check(&u));
+	release_tssb(&u);
+
+	u = prepare_tssb_mmap(filename, NULL, 0);
+	TEST("index_tssb32", index32_check(&u));
+	release_tssb(&u);
+
+	u = prepare_tssb_mmap(filename, NULL, 0);
+	TEST("hash_tssb", hash_check(&u));
+	release_tssb(&u);
+	TEST("hash_tssb with short row in stackmem", short_row_hash_check());
+
+	TEST("stream_tssb", stream_check(4096));
+	TEST("stream_tssb with tiny chunks", stream_check(3));
+
+	TEST("share_tssb", shared_check());
+
+	TEST("prepare_tssb_indexed", indexed_check());
+	TEST("TSSB_BUILD_POOLED and prepare_tssb_indexed_addr", pooled_check());
+	TEST("gather_tssb family", gather_check());
+
+	TEST("index_tssb32 with huge table", huge_index32_check());
+
+	u = prepare_tssb_addr(SOURCE_ADDR, binary, sizeof(binary), NULL, 0);
+	TEST("prepare_tssb_addr", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	u = check_tssb_addr(binary, sizeof(binary));
+	char addrmem[TSSB_CALCULATE(u)];
+	u = prepare_tssb_addr(SOURCE_ADDR, binary, sizeof(binary), addrmem, sizeof(addrmem));
+	TEST("prepare_tssb_addr with stackmem", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	char inplace[sizeof(binary)];
+	memcpy(inplace, binary, sizeof(binary)); // writable, because big endian platforms are swapping sizes
+	u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, inplace, sizeof(inplace), NULL, 0);
+	TEST("prepare_tssb_addr in place", consistency_check(&u, parse_tssb(&u)) and u.source == inplace);
+	release_tssb(&u);
+
+	u = prepare_tssb_addr(SOURCE_ADDR_INPLACE, inplace, sizeof(inplace), tablemem, sizeof(tablemem));
+	TEST("prepare_tssb_addr in place with stackmem", consistency_check(&u, parse_tssb(&u)));
+	release_tssb(&u);
+
+	u = prepare_tssb_addr(SOURCE_ADDR, binary, 20, NULL, 0);
+	TEST("prepare_tssb_addr with truncated header", u.errreasonstr == err_not_a_valid_tssb);
+
+	TEST("parse_tssb with truncated cell", malformed_check(sizeof(binary) - 2, 0, 0));
+	TEST("parse_tssb with truncated size field", malformed_check(sizeof(binary) - 4, 0, 0));
+	TEST("parse_tssb with cell beyond the end", malformed_check(sizeof(binary), 43, UINT16_MAX - 1));
+
+	TEST("build_tssb with 8 bit sizes", builder_check(3, sizeof(uint8_t)));
+	TEST("build_tssb with 16 bit sizes", builder_check(UINT8_MAX, sizeof(uint16_t)));
+	TEST("build_tssb with 32 bit sizes", builder_check(UINT16_MAX, sizeof(uint32_t)));
+
+	unlink(filename);
+	return retval;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2021, Xdevelnet (xdevelnet at xdevelnet dot org)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <libssb_uring.c>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <poll.h>
+
+const char essb_binary[108] = "SSBTEMPLATE0\x09\x00\x00\x00\x34\x00\x00\x00\x46irst text1sttagSCNDSABCD EFGBEBRASKOTINYAKI_TAKI!z\n\x0A\x00\x00\x00\xFA\xFF\xFF\xFF\x04\x00\x00\x00\xFF\xFF\xFF\xFF\xF8\xFF\xFF\xFF\x05\x00\x00\x00\xF0\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01\x00\x00\x00";
+#define TSSB_FILES 6
+#define FILES (TSSB_FILES + 4) // two ESSB files, absent one and garbage
+
+#define TESTT(operand, operator, operand2) if(!(operand operator operand2)) do {printf("Condition: %s Evaluated %ld Expected: %ld\n", #operand " " #operator " " #operand2, (long) operand, (long) operand2); retval = false;} while(0)
+#define TESTTSTR(tested_str, expected) if (memcmp(tested_str, expected, strizeof(expected)) != 0) do{printf("Condition: %s Expected %s\n", #tested_str , expected); retval = false;} while(0)
+
+char filenames[FILES][32];
+
+static bool write_file(const char *name, const void *data, size_t size) {
+	int fd = open(name, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0) return false;
+	ssize_t got = write(fd, data, size);
+	close(fd);
+	return got == (ssize_t) size;
+}
+
+static bool prepare_files(void) {
+	// above
+	// First files are TSSB with their number in the only cell (and one big cell, so read may be split), then ESSB.
+
+	static char big[200000];
+	memset(big, 'x', sizeof(big));
+	for (int i = 0; i < FILES; i++) snprintf(filenames[i], sizeof(filenames[i]), "testdata_uring_%d.ssb", i);
+	for (int i = 0; i < TSSB_FILES; i++) {
+		char cell[8];
+		snprintf(cell, sizeof(cell), "%02d", i);
+		tssb_builder b = {0};
+		add_tssb_row(&b);
+		add_tssb_cell(&b, cell, 2);
+		add_tssb_cell(&b, big, sizeof(big));
+		int fd = open(filenames[i], O_CREAT | O_TRUNC | O_WRONLY, 0600);
+		bool written = fd >= 0 and write_tssb(&b, fd);
+		if (fd >= 0) close(fd);
+		release_tssb_builder(&b);
+		if (written == false) return false;
+	}
+	return write_file(filenames[TSSB_FILES], essb_binary, sizeof(essb_binary)) and
+		write_file(filenames[TSSB_FILES + 1], essb_binary, sizeof(essb_binary)) and
+		write_file(filenames[TSSB_FILES + 3], "garbage", 7); // TSSB_FILES + 2 is absent
+}
+
+static bool load_check(unsigned entries, bool expect_ring) {
+	bool retval = true;
+	ssb_uring r = {0};
+	if (start_ssb_uring(&r, entries) == false) return printf("%s\n", r.errreasonstr), false;
+	if (expect_ring and r.ring_fd < 0) printf("io_uring is unavailable, synchronous loading is checked instead\n");
+
+	ssb_load_request requests[FILES];
+	for (int i = 0; i < FILES; i++) {
+		requests[i].userdata = requests + i;
+		if (submit_ssb_load(&r, requests + i, filenames[i]) == false) retval = false;
+	}
+
+	// event loop: wait for event_fd, then take whatever is completed
+	size_t completed = 0;
+	ssb_load_request *done[3];
+	for (int spins = 0; completed < FILES and spins < 1000; spins++) {
+		struct pollfd fds = {.fd = r.event_fd, .events = POLLIN};
+		if (poll(&fds, 1, 1000) <= 0) break;
+		size_t got = complete_ssb_loads(&r, done, sizeof(done) / sizeof(done[0]));
+		for (size_t i = 0; i < got; i++) TESTT(done[i]->userdata, ==, done[i]);
+		completed += got;
+	}
+	TESTT(completed, ==, FILES);
+
+	for (int i = 0; i < TSSB_FILES; i++) {
+		ssb_loaded *f = &requests[i].result;
+		char cell[8];
+		snprintf(cell, sizeof(cell), "%02d", i);
+		TESTT(f->errreasonstr, ==, NULL);
+		TESTT(f->is_essb, ==, false);
+		if (f->table == NULL or memcmp(f->table[0][0], cell, 2) != 0) retval = false;
+		else TESTT(getssbsize(f->table[0][1], f->u, &(size_t){0}), ==, 200000);
+	}
+	for (int i = TSSB_FILES; i < TSSB_FILES + 2; i++) {
+		TESTT(requests[i].result.errreasonstr, ==, NULL);
+		TESTT(requests[i].result.is_essb, ==, true);
+		TESTT(requests[i].result.e.records_amount, ==, 9);
+		if (requests[i].result.e.record_seek != NULL) TESTT(requests[i].result.e.record_seek[8], ==, 51);
+	}
+	TESTT(requests[TSSB_FILES + 2].result.errreasonstr, !=, NULL);
+	TESTT(requests[TSSB_FILES + 3].result.errreasonstr, ==, err_not_a_valid_essb);
+
+	for (int i = 0; i < FILES; i++) release_ssb_load(requests + i);
+	stop_ssb_uring(&r);
+	return retval;
+}
+
+static bool stop_check(void) {
+	// above
+	// Requests which are in progress during stop must be waited for and released.
+
+	ssb_uring r = {0};
+	if (start_ssb_uring(&r, 2) == false) return false;
+	ssb_load_request requests[FILES];
+	for (int i = 0; i < FILES; i++) submit_ssb_load(&r, requests + i, filenames[i]);
+	stop_ssb_uring(&r);
+	return r.done == NULL and r.inflight == 0;
+}
+
+#define TEST(a, foo) do {printf("Test: %s. Result: %s\n", a, (foo) ? "passed" : (retval = EXIT_FAILURE, "failed"));} while(0)
+
+int main(int argc, char **argv) {
+	int retval = EXIT_SUCCESS;
+
+	if (prepare_files() == false) {
+		printf("Can't prepare files for testing io_uring loading. Reason: %s\n", strerror(errno));
+		retval = EXIT_FAILURE;
+		goto exit;
+	}
+
+	TEST("io_uring loading", load_check(4, true));
+	TEST("io_uring loading with tiny ring", load_check(1, true));
+	TEST("synchronous loading", load_check(0, false));
+	TEST("stop with requests in progress", stop_check());
+
+	exit:
+	for (int i = 0; i < FILES; i++) unlink(filenames[i]);
+	return retval;
+}